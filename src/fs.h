@@ -25,16 +25,56 @@
  */
 bool shouldSkipPath(const std::string& path);
 
+/**
+ * @brief Returns the user's home directory
+ * 
+ * Uses USERPROFILE on Windows and HOME on Unix-like systems.
+ * 
+ * @return std::string The home directory, or an empty string if unknown
+ */
+std::string getHomeDirectory();
+
+/**
+ * @brief Returns the directory where the explorer keeps its state files
+ * 
+ * This is ".optimized_explorer" in the user's home directory. It is not
+ * created here; callers create it when they first write to it.
+ * 
+ * @return std::filesystem::path The state directory
+ */
+std::filesystem::path getStateDirectory();
+
+/**
+ * @brief Escapes backslashes and newlines so a value fits on one line
+ * 
+ * Used for paths in the explorer's text state files (checkpoints, manifests).
+ * 
+ * @param value The value to escape
+ * @return std::string The escaped value
+ */
+std::string escapeLine(const std::string& value);
+
+/**
+ * @brief Reverses escapeLine
+ */
+std::string unescapeLine(const std::string& value);
+
 /**
  * @brief Searches for files and directories by name
  * 
  * This function performs a recursive search through the specified directory,
  * looking for files and directories whose names contain the search term.
  * The search is case-insensitive and handles errors gracefully.
- * 
- * @param directory The path to start the search from
+ * Progress is checkpointed periodically and on Ctrl-C, so an interrupted
+ * search can be continued with resume set. Directories are listed in
+ * parallel, with a separate queue and concurrency limit per device.
+ * 
+ * @param directory The path to start the search from (may be empty when resuming)
+ * @param resume true to continue the last interrupted search
+ * @param sameDevice true to stay on the file system of the directory (--xdev)
+ * @param nice true to rate limit disk reads with the --nice limits
  */
-void fsSearch(const std::string& directory);
+void fsSearch(const std::string& directory, bool resume, bool sameDevice, bool nice);
 
 /**
  * @brief Displays the contents of a directory recursively
@@ -42,10 +82,14 @@ void fsSearch(const std::string& directory);
  * This function traverses through a directory and its subdirectories,
  * displaying all files and folders it finds. It handles errors gracefully
  * and skips system directories and files that should not be accessed.
+ * Progress is checkpointed and directories are listed like for fsSearch.
  * 
- * @param directory The path to the directory to display
+ * @param directory The path to the directory to display (may be empty when resuming)
+ * @param resume true to continue the last interrupted display
+ * @param sameDevice true to stay on the file system of the directory (--xdev)
+ * @param nice true to rate limit disk reads with the --nice limits
  */
-void fsDisplay(const std::string& directory);
+void fsDisplay(const std::string& directory, bool resume, bool sameDevice, bool nice);
 
 /**
  * @brief Changes the current working directory
@@ -59,6 +103,26 @@ void fsDisplay(const std::string& directory);
  */
 bool fsCd(const std::string& directory);
 
+/**
+ * @brief Jumps to a previously visited directory matching a fragment
+ * 
+ * Directories visited with cd are ranked by frecency (how often and how
+ * recently they were visited). The best ranked directory whose path contains
+ * all words of the fragment, in order and ignoring case, becomes the current
+ * directory. With an empty fragment the best ranked directories are listed.
+ * 
+ * @param fragment Words to look for in the directory path
+ * @return true if the directory was changed (or the list shown), false otherwise
+ */
+bool fsJump(const std::string& fragment);
+
+/**
+ * @brief Records a visit to a directory in the frecency database used by fsJump
+ * 
+ * @param directory The absolute path of the visited directory
+ */
+void recordDirectoryVisit(const std::string& directory);
+
 /**
  * @brief Gets the current working directory
  * 
@@ -89,9 +153,10 @@ bool fsCreate(const std::string& path, bool isDirectory);
  * directory cannot be deleted.
  * 
  * @param path The path to the file or directory to delete
+ * @param nice true to pace the deletion with the --nice rate limits
  * @return true if deletion was successful, false otherwise
  */
-bool fsDelete(const std::string& path);
+bool fsDelete(const std::string& path, bool nice);
 
 /**
  * @brief Renames or moves a file or directory
@@ -104,4 +169,78 @@ bool fsDelete(const std::string& path);
  * @param newPath The new path for the file or directory
  * @return true if rename was successful, false otherwise
  */
-bool fsRename(const std::string& oldPath, const std::string& newPath); 
\ No newline at end of file
+bool fsRename(const std::string& oldPath, const std::string& newPath);
+
+/**
+ * @brief Lists the largest or most recently modified files under a directory
+ * 
+ * Walks the directory in parallel, reading it from disk without adding it to
+ * the directory cache, and keeps only the best candidates in small per-thread
+ * heaps. Memory use depends on the number of requested files and the
+ * directories waiting to be read, not on the size of the tree. Sizes and
+ * times are read on every run, so changes made outside the explorer show up.
+ * 
+ * @param directory The path to start from
+ * @param byModificationTime true to rank by modification time, false by size
+ * @param count How many files to report
+ */
+void fsTop(const std::string& directory, bool byModificationTime, size_t count);
+
+/**
+ * @brief Shows or clears the shared in-memory directory cache
+ * 
+ * Without an option, prints how many entries are cached and how much memory
+ * they use. With "clear", drops the cache so that the next commands reread
+ * everything from disk (useful after changes made outside the explorer).
+ * 
+ * @param option Empty or "clear"
+ */
+void fsCache(const std::string& option);
+
+/**
+ * @brief Shows or changes the rate limits used by --nice
+ * 
+ * Settings are "name=value" pairs: directories, entries and bytes per second
+ * (0 for unlimited, bytes may end in K, M or G) and idle=on|off for the idle
+ * I/O scheduling class. "reset" restores the defaults. The limits are saved
+ * in the state directory, where commands already running with --nice pick
+ * them up within a second.
+ * 
+ * @param settings Empty to show the limits, otherwise the changes
+ */
+void fsNice(const std::string& settings);
+
+/**
+ * @brief Writes a checksum manifest of every regular file below a directory
+ * 
+ * Files are hashed in parallel with large sequential reads. If the output
+ * file already holds a manifest of the same directory and algorithm, files
+ * whose size, modification time and inode are unchanged keep their digest
+ * without being read. Symbolic links are not followed or recorded.
+ * 
+ * @param directory The directory to describe
+ * @param manifestPath The manifest file to write (replaced atomically)
+ * @param sha256 true for SHA-256, false for the faster XXH64
+ * @param nice true to pace reads with the --nice limits
+ * @return true if every file was hashed
+ */
+bool fsManifestCreate(const std::string& directory, const std::string& manifestPath, bool sha256, bool nice);
+
+/**
+ * @brief Checks a directory against its manifest
+ * 
+ * Reports files that were modified, are missing, cannot be read, are no
+ * longer regular files (e.g. replaced by a symbolic link), or are new since
+ * the manifest was written. Files whose size, modification time and inode
+ * match their record are not reread unless full is set. The manifest is
+ * left untouched unless update is set; then files with new metadata but the
+ * same content get their record updated so the next verify can skip them.
+ * Digests are never changed.
+ * 
+ * @param manifestPath The manifest file
+ * @param full true to rehash every file
+ * @param update true to record new metadata of unchanged files (--update)
+ * @param nice true to pace reads with the --nice limits
+ * @return true if the tree matches the manifest
+ */
+bool fsManifestVerify(const std::string& manifestPath, bool full, bool update, bool nice); 
\ No newline at end of file
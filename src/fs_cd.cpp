@@ -30,11 +30,8 @@ bool fsCd(const std::string& directory) {
             return true;
         } else if (directory == "~") {
             // Go to user's home directory
-            const char* homeDir = std::getenv("USERPROFILE"); // Windows
-            if (!homeDir) {
-                homeDir = std::getenv("HOME"); // Unix-like systems
-            }
-            if (!homeDir) {
+            std::string homeDir = getHomeDirectory();
+            if (homeDir.empty()) {
                 std::cerr << "Error: Could not determine home directory\n";
                 return false;
             }
@@ -75,6 +72,7 @@ bool fsCd(const std::string& directory) {
         // Update current working directory
         currentWorkingDirectory = canonicalPath;
         std::cout << "Changed directory to: " << currentWorkingDirectory.string() << "\n";
+        recordDirectoryVisit(currentWorkingDirectory.string());
         return true;
 
     } catch (const std::exception& e) {
@@ -0,0 +1,170 @@
+/**
+ * @file fs_checkpoint.cpp
+ * @brief Implementation of traversal checkpoints
+ *
+ * Checkpoints are small text files in the state directory, one per command.
+ * They are written to a temporary file first and then renamed over the old
+ * one, so an interruption while saving never leaves a torn checkpoint.
+ */
+
+#include "fs_checkpoint.h"
+#include "fs.h"
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* CHECKPOINT_HEADER = "optimized_explorer checkpoint 2";
+
+// Written before --xdev existed; lacks the device line
+const char* CHECKPOINT_HEADER_V1 = "optimized_explorer checkpoint 1";
+
+volatile std::sig_atomic_t interruptReceived = 0;
+
+void onInterrupt(int) {
+    interruptReceived = 1;
+}
+
+fs::path checkpointPath(const std::string& command) {
+    return getStateDirectory() / (command + ".checkpoint");
+}
+
+} // namespace
+
+bool saveCheckpoint(const TraversalCheckpoint& checkpoint) {
+    std::error_code ec;
+    fs::path target = checkpointPath(checkpoint.command);
+    fs::create_directories(target.parent_path(), ec);
+
+    fs::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << CHECKPOINT_HEADER << "\n"
+            << escapeLine(checkpoint.root) << "\n"
+            << escapeLine(checkpoint.term) << "\n"
+            << checkpoint.results << "\n"
+            << (checkpoint.sameDevice ? 1 : 0) << "\n"
+            << checkpoint.pending.size() << "\n";
+        for (const auto& path : checkpoint.pending) {
+            out << escapeLine(path) << "\n";
+        }
+        if (!out.flush()) {
+            return false;
+        }
+    }
+
+    fs::rename(temporary, target, ec);
+    return !ec;
+}
+
+bool loadCheckpoint(const std::string& command, const std::string& directory,
+                    TraversalCheckpoint& checkpoint) {
+    std::ifstream in(checkpointPath(command));
+    if (!in) {
+        std::cerr << "Error: There is no interrupted " << command << " to resume\n";
+        return false;
+    }
+
+    std::string header, root, term, results, sameDevice, count;
+    std::getline(in, header);
+    std::getline(in, root);
+    std::getline(in, term);
+    std::getline(in, results);
+    if (header == CHECKPOINT_HEADER) {
+        std::getline(in, sameDevice);
+    } else if (header == CHECKPOINT_HEADER_V1) {
+        sameDevice = "0";
+    }
+    std::getline(in, count);
+    if (!in || sameDevice.empty()) {
+        std::cerr << "Error: The " << command << " checkpoint is damaged\n";
+        return false;
+    }
+
+    size_t pendingCount = 0;
+    bool valid;
+    try {
+        size_t resultsUsed = 0, countUsed = 0;
+        checkpoint.results = std::stoull(results, &resultsUsed);
+        pendingCount = std::stoull(count, &countUsed);
+        valid = resultsUsed == results.size() && countUsed == count.size();
+    } catch (const std::logic_error&) {
+        // Not a number, or out of range
+        valid = false;
+    }
+    if (!valid) {
+        std::cerr << "Error: The " << command << " checkpoint is damaged\n";
+        return false;
+    }
+
+    checkpoint.command = command;
+    checkpoint.root = unescapeLine(root);
+    checkpoint.term = unescapeLine(term);
+    checkpoint.sameDevice = sameDevice == "1";
+    checkpoint.pending.clear();
+
+    std::string line;
+    while (checkpoint.pending.size() < pendingCount && std::getline(in, line)) {
+        checkpoint.pending.push_back(unescapeLine(line));
+    }
+    if (checkpoint.pending.size() != pendingCount) {
+        std::cerr << "Error: The " << command << " checkpoint is damaged\n";
+        return false;
+    }
+
+    if (!directory.empty() &&
+        fs::absolute(directory).lexically_normal() != fs::path(checkpoint.root).lexically_normal()) {
+        std::cerr << "Error: The interrupted " << command << " was started in '"
+                  << checkpoint.root << "', not '" << directory << "'\n";
+        return false;
+    }
+    return true;
+}
+
+void discardCheckpoint(const std::string& command) {
+    std::error_code ec;
+    fs::remove(checkpointPath(command), ec);
+}
+
+CheckpointSchedule::CheckpointSchedule(std::chrono::seconds interval)
+    : interval(interval), next(std::chrono::steady_clock::now() + interval) {
+}
+
+bool CheckpointSchedule::due() {
+    auto now = std::chrono::steady_clock::now();
+    if (now < next) {
+        return false;
+    }
+    next = now + interval;
+    return true;
+}
+
+InterruptGuard::InterruptGuard() {
+    interruptReceived = 0;
+    previousInterrupt = std::signal(SIGINT, onInterrupt);
+#ifdef SIGHUP
+    previousHangup = std::signal(SIGHUP, onInterrupt);
+#else
+    previousHangup = SIG_DFL;
+#endif
+}
+
+InterruptGuard::~InterruptGuard() {
+    std::signal(SIGINT, previousInterrupt == SIG_ERR ? SIG_DFL : previousInterrupt);
+#ifdef SIGHUP
+    std::signal(SIGHUP, previousHangup == SIG_ERR ? SIG_DFL : previousHangup);
+#endif
+}
+
+bool InterruptGuard::interrupted() const {
+    return interruptReceived != 0;
+}
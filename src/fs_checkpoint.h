@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @file fs_checkpoint.h
+ * @brief Checkpoints that let long-running traversals be resumed
+ *
+ * A traversal periodically writes its pending-directory frontier and the
+ * number of results reported so far to a small state file. If it is
+ * interrupted (Ctrl-C, lost terminal, crash) the command can be rerun with
+ * --resume to continue from the last checkpoint instead of starting over.
+ */
+
+/**
+ * @brief Everything needed to continue a traversal
+ */
+struct TraversalCheckpoint {
+    std::string command;                // "search" or "display"
+    std::string root;                   // Absolute path the traversal started at
+    std::string term;                   // Search term, empty for display
+    uint64_t results = 0;               // Matches / items reported so far
+    bool sameDevice = false;            // Started with --xdev
+    std::vector<std::string> pending;   // Absolute paths still to be listed
+};
+
+/**
+ * @brief Writes a checkpoint, replacing the previous one atomically
+ *
+ * @return true if the checkpoint was written
+ */
+bool saveCheckpoint(const TraversalCheckpoint& checkpoint);
+
+/**
+ * @brief Loads the checkpoint of a command for --resume
+ *
+ * Prints an error if there is no checkpoint, or if directory is not empty
+ * and differs from the directory the checkpoint was taken for.
+ *
+ * @param command The command whose checkpoint to load
+ * @param directory The directory given on the command line, may be empty
+ * @param checkpoint Receives the checkpoint
+ * @return true if the checkpoint was loaded
+ */
+bool loadCheckpoint(const std::string& command, const std::string& directory,
+                    TraversalCheckpoint& checkpoint);
+
+/**
+ * @brief Removes the checkpoint of a command once it has completed
+ */
+void discardCheckpoint(const std::string& command);
+
+/**
+ * @brief Decides when the next periodic checkpoint is due
+ *
+ * due() is polled by the walk monitor a few times per second, outside the
+ * workers, so checkpointing does not slow the walk down.
+ */
+class CheckpointSchedule {
+public:
+    explicit CheckpointSchedule(std::chrono::seconds interval = std::chrono::seconds(10));
+
+    bool due();
+
+private:
+    std::chrono::steady_clock::duration interval;
+    std::chrono::steady_clock::time_point next;
+};
+
+/**
+ * @brief Catches Ctrl-C and hangups while a traversal is running
+ *
+ * Installs the handlers on construction and restores the previous ones on
+ * destruction, so Ctrl-C at the prompt keeps its usual meaning.
+ */
+class InterruptGuard {
+public:
+    InterruptGuard();
+    ~InterruptGuard();
+
+    InterruptGuard(const InterruptGuard&) = delete;
+    InterruptGuard& operator=(const InterruptGuard&) = delete;
+
+    bool interrupted() const;
+
+private:
+    void (*previousInterrupt)(int);
+    void (*previousHangup)(int);
+};
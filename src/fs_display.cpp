@@ -1,12 +1,16 @@
 //Used for displaying the files and directories in the current directory
 
 #include "fs.h"
+#include "fs_checkpoint.h"
+#include "fs_throttle.h"
+#include "fs_tree.h"
+#include "fs_walk.h"
 #include <iostream>
 #include <filesystem>
 #include <string>
-#include <stack>
 #include <vector>
-#include <algorithm>
+#include <mutex>
+#include <optional>
 
 namespace fs = std::filesystem;
 
@@ -18,69 +22,113 @@ namespace fs = std::filesystem;
  * and skips system directories and files that should not be accessed.
  * 
  * @param directory The path to the directory to display
+ * @param resume true to continue the last interrupted display
+ * @param sameDevice true to stay on the file system of the directory (--xdev)
+ * @param nice true to rate limit disk reads with the --nice limits
  */
-void fsDisplay(const std::string& directory) {
+void fsDisplay(const std::string& directory, bool resume, bool sameDevice, bool nice) {
     try {
-        if (!fs::exists(directory)) {
-            std::cerr << "Error: The path '" << directory << "' does not exist.\n";
+        TraversalCheckpoint checkpoint;
+        std::string root = directory;
+
+        if (resume) {
+            if (!loadCheckpoint("display", directory, checkpoint)) {
+                return;
+            }
+            root = checkpoint.root;
+        }
+
+        if (!fs::exists(root)) {
+            std::cerr << "Error: The path '" << root << "' does not exist.\n";
             return;
         }
 
-        std::cout << "Displaying contents of: " << directory << "\n\n";
+        std::cout << (resume ? "Resuming display of: " : "Displaying contents of: ") << root << "\n\n";
         
-        if (!fs::is_directory(directory)) {
-            std::cout << "[FILE] " << fs::absolute(directory).string() << "\n";
+        if (!fs::is_directory(root)) {
+            std::cout << "[FILE] " << fs::absolute(root).string() << "\n";
             return;
         }
 
-        std::stack<fs::path> directoryStack;
-        directoryStack.push(fs::path(directory));
-        int itemCount = 0;
-
-        while (!directoryStack.empty()) {
-            auto currentDir = directoryStack.top();
-            directoryStack.pop();
+        // Directories are read in parallel through the shared tree, so
+        // anything listed by an earlier command is served from memory
+        TreeWalker walker;
+        std::mutex outputMutex;
 
-            try {
-                if (shouldSkipPath(currentDir.string())) {
-                    continue;
-                }
-
-                std::cout << "\n[DIR] " << currentDir.string() << "\n";
-                const auto dirOptions = fs::directory_options::skip_permission_denied;
-                std::error_code errorCode;
-                
-                for (const auto& entry : fs::directory_iterator(currentDir, dirOptions, errorCode)) {
-                    try {
-                        const auto& entryPath = entry.path();
-                        
-                        if (shouldSkipPath(entryPath.string())) {
-                            continue;
-                        }
+        if (resume) {
+            for (const auto& pending : checkpoint.pending) {
+                walker.add(fs::path(pending));
+            }
+            walker.setResults(checkpoint.results);
+            sameDevice = checkpoint.sameDevice;
+        } else {
+            walker.add(fs::path(root));
+            checkpoint.command = "display";
+            checkpoint.root = fs::absolute(root).lexically_normal().string();
+            checkpoint.sameDevice = sameDevice;
+        }
+        walker.setSameDevice(sameDevice);
 
-                        // Indent subdirectory contents for better readability
-                        std::cout << "  " << (fs::is_directory(entryPath, errorCode) ? "[DIR] " : "[FILE] ")
-                                 << entryPath.filename().string() << "\n";
-                        itemCount++;
+        // --nice paces disk reads; the limits can change while it runs
+        std::optional<IoThrottle> throttle;
+        if (nice) {
+            throttle.emplace(loadThrottleLimits());
+            walker.setThrottle(&*throttle);
+        }
 
-                        if (fs::is_directory(entryPath, errorCode)) {
-                            directoryStack.push(entryPath);
-                        }
-                    } catch (...) {
-                        continue;
-                    }
-                }
+        // Items are counted through the walker to match the saved frontier, see fsSearch
+        CheckpointSchedule schedule;
+        InterruptGuard interrupt;
+        auto recordCheckpoint = [&](const std::vector<fs::path>& pending, uint64_t results) {
+            checkpoint.results = results;
+            checkpoint.pending.clear();
+            for (const auto& path : pending) {
+                checkpoint.pending.push_back(fs::absolute(path).string());
+            }
+            saveCheckpoint(checkpoint);
+        };
 
-                if (errorCode) {
-                    std::cerr << "Warning: Some entries in " << currentDir << " could not be accessed\n";
-                }
+        walker.run([&](unsigned worker, const WalkDirectory& current,
+                       const std::vector<FsTree::Entry>& entries, const std::error_code& errorCode) {
+            // Each directory is printed as one block so that blocks from
+            // different workers do not interleave
+            std::string output = "\n[DIR] " + current.path.string() + "\n";
+            for (const auto& entry : entries) {
+                // Indent subdirectory contents for better readability
+                output += entry.isDirectory ? "  [DIR] " : "  [FILE] ";
+                output += entry.name;
+                output += "\n";
+            }
 
-            } catch (...) {
-                continue;
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << output;
+            walker.countResults(worker, entries.size());
+            if (errorCode) {
+                std::cerr << "Warning: Some entries in " << current.path << " could not be accessed\n";
+            }
+        }, [&]() {
+            if (interrupt.interrupted()) {
+                return false;
+            }
+            if (throttle) {
+                throttle->poll();
             }
+            if (schedule.due()) {
+                walker.snapshot(recordCheckpoint);
+            }
+            return true;
+        });
+
+        if (interrupt.interrupted()) {
+            recordCheckpoint(walker.remaining(), walker.results());
+            std::cout << "\nDisplay interrupted after " << walker.results()
+                      << " items; continue it with: display --resume\n";
+            return;
         }
+
+        discardCheckpoint("display");
         
-        std::cout << "\nTotal items found: " << itemCount << "\n";
+        std::cout << "\nTotal items found: " << walker.results() << "\n";
     } catch (const std::exception& e) {
         std::cerr << "Error during directory display: " << e.what() << "\n";
     }
@@ -0,0 +1,367 @@
+/**
+ * @file fs_hash.cpp
+ * @brief Implementation of XXH64, SHA-256 and file hashing
+ */
+
+#include "fs_hash.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Size of the blocks files are read in
+ */
+const size_t READ_BLOCK = 1 << 20;
+
+const uint64_t XXH_PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t XXH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t XXH_PRIME3 = 0x165667B19E3779F9ULL;
+const uint64_t XXH_PRIME4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t XXH_PRIME5 = 0x27D4EB2F165667C5ULL;
+
+const uint32_t SHA256_ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+uint64_t rotateLeft64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+uint32_t rotateRight32(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+uint64_t readLittle64(const unsigned char* data) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+uint32_t readLittle32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8
+         | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+uint32_t readBig32(const unsigned char* data) {
+    return static_cast<uint32_t>(data[0]) << 24 | static_cast<uint32_t>(data[1]) << 16
+         | static_cast<uint32_t>(data[2]) << 8 | static_cast<uint32_t>(data[3]);
+}
+
+uint64_t xxhRound(uint64_t accumulator, uint64_t input) {
+    accumulator += input * XXH_PRIME2;
+    accumulator = rotateLeft64(accumulator, 31);
+    return accumulator * XXH_PRIME1;
+}
+
+uint64_t xxhMergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= xxhRound(0, value);
+    return accumulator * XXH_PRIME1 + XXH_PRIME4;
+}
+
+std::string toHex(const unsigned char* bytes, size_t length) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(length * 2);
+    for (size_t i = 0; i < length; i++) {
+        hex += digits[bytes[i] >> 4];
+        hex += digits[bytes[i] & 15];
+    }
+    return hex;
+}
+
+/**
+ * @brief Feeds a file to a hasher block by block
+ */
+template <typename Hasher>
+bool streamFile(const fs::path& path, Hasher& hasher, IoThrottle* throttle, uint64_t& bytesRead) {
+    // One buffer per thread, reused for every file it hashes
+    thread_local std::vector<unsigned char> block(READ_BLOCK);
+    bytesRead = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+    // A symbolic link swapped in for the file is not followed
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) {
+        return false;
+    }
+#if defined(__linux__)
+    // Doubles the kernel's read-ahead window for this file
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    bool complete = true;
+    while (true) {
+        ssize_t count = ::read(fd, block.data(), block.size());
+        if (count < 0) {
+            complete = false;
+            break;
+        }
+        if (count == 0) {
+            break;
+        }
+        if (throttle) {
+            throttle->acquireBytes(static_cast<uint64_t>(count));
+        }
+        hasher.update(block.data(), static_cast<size_t>(count));
+        bytesRead += static_cast<uint64_t>(count);
+    }
+    ::close(fd);
+    return complete;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    while (in) {
+        in.read(reinterpret_cast<char*>(block.data()), static_cast<std::streamsize>(block.size()));
+        std::streamsize count = in.gcount();
+        if (count <= 0) {
+            break;
+        }
+        if (throttle) {
+            throttle->acquireBytes(static_cast<uint64_t>(count));
+        }
+        hasher.update(block.data(), static_cast<size_t>(count));
+        bytesRead += static_cast<uint64_t>(count);
+    }
+    return in.eof();
+#endif
+}
+
+} // namespace
+
+const char* hashName(HashAlgorithm algorithm) {
+    return algorithm == HashAlgorithm::SHA256 ? "sha256" : "xxh64";
+}
+
+bool parseHashName(const std::string& name, HashAlgorithm& algorithm) {
+    if (name == "xxh64") {
+        algorithm = HashAlgorithm::XXH64;
+        return true;
+    }
+    if (name == "sha256") {
+        algorithm = HashAlgorithm::SHA256;
+        return true;
+    }
+    return false;
+}
+
+Xxh64::Xxh64(uint64_t seed) : seed(seed) {
+    accumulators[0] = seed + XXH_PRIME1 + XXH_PRIME2;
+    accumulators[1] = seed + XXH_PRIME2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - XXH_PRIME1;
+}
+
+void Xxh64::update(const unsigned char* data, size_t length) {
+    totalLength += length;
+
+    // Top up a partial stripe left over from the previous call
+    if (buffered > 0) {
+        size_t take = std::min(length, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, data, take);
+        buffered += take;
+        data += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        for (int lane = 0; lane < 4; lane++) {
+            accumulators[lane] = xxhRound(accumulators[lane], readLittle64(buffer + lane * 8));
+        }
+        buffered = 0;
+    }
+
+    // Whole 32-byte stripes, four independent lanes
+    while (length >= 32) {
+        accumulators[0] = xxhRound(accumulators[0], readLittle64(data));
+        accumulators[1] = xxhRound(accumulators[1], readLittle64(data + 8));
+        accumulators[2] = xxhRound(accumulators[2], readLittle64(data + 16));
+        accumulators[3] = xxhRound(accumulators[3], readLittle64(data + 24));
+        data += 32;
+        length -= 32;
+    }
+
+    std::memcpy(buffer, data, length);
+    buffered = length;
+}
+
+std::string Xxh64::hexDigest() const {
+    uint64_t hash;
+    if (totalLength >= 32) {
+        hash = rotateLeft64(accumulators[0], 1) + rotateLeft64(accumulators[1], 7)
+             + rotateLeft64(accumulators[2], 12) + rotateLeft64(accumulators[3], 18);
+        for (int lane = 0; lane < 4; lane++) {
+            hash = xxhMergeRound(hash, accumulators[lane]);
+        }
+    } else {
+        hash = seed + XXH_PRIME5;
+    }
+    hash += totalLength;
+
+    const unsigned char* tail = buffer;
+    size_t remaining = buffered;
+    while (remaining >= 8) {
+        hash ^= xxhRound(0, readLittle64(tail));
+        hash = rotateLeft64(hash, 27) * XXH_PRIME1 + XXH_PRIME4;
+        tail += 8;
+        remaining -= 8;
+    }
+    if (remaining >= 4) {
+        hash ^= static_cast<uint64_t>(readLittle32(tail)) * XXH_PRIME1;
+        hash = rotateLeft64(hash, 23) * XXH_PRIME2 + XXH_PRIME3;
+        tail += 4;
+        remaining -= 4;
+    }
+    while (remaining > 0) {
+        hash ^= *tail * XXH_PRIME5;
+        hash = rotateLeft64(hash, 11) * XXH_PRIME1;
+        tail++;
+        remaining--;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+
+    // Canonical form is big endian
+    unsigned char bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = static_cast<unsigned char>(hash >> (56 - 8 * i));
+    }
+    return toHex(bytes, sizeof(bytes));
+}
+
+Sha256::Sha256() {
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    std::memcpy(state, initial, sizeof(state));
+}
+
+void Sha256::compress(const unsigned char* block) {
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; i++) {
+        schedule[i] = readBig32(block + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = rotateRight32(schedule[i - 15], 7) ^ rotateRight32(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t s1 = rotateRight32(schedule[i - 2], 17) ^ rotateRight32(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = rotateRight32(e, 6) ^ rotateRight32(e, 11) ^ rotateRight32(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + s1 + choice + SHA256_ROUND_CONSTANTS[i] + schedule[i];
+        uint32_t s0 = rotateRight32(a, 2) ^ rotateRight32(a, 13) ^ rotateRight32(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = s0 + majority;
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(const unsigned char* data, size_t length) {
+    totalLength += length;
+
+    if (buffered > 0) {
+        size_t take = std::min(length, sizeof(buffer) - buffered);
+        std::memcpy(buffer + buffered, data, take);
+        buffered += take;
+        data += take;
+        length -= take;
+        if (buffered < sizeof(buffer)) {
+            return;
+        }
+        compress(buffer);
+        buffered = 0;
+    }
+
+    while (length >= 64) {
+        compress(data);
+        data += 64;
+        length -= 64;
+    }
+
+    std::memcpy(buffer, data, length);
+    buffered = length;
+}
+
+std::string Sha256::hexDigest() const {
+    // Padding is applied to a copy, so the hasher itself stays usable
+    Sha256 final = *this;
+    uint64_t bitLength = totalLength * 8;
+
+    unsigned char padding[72] = {0x80};
+    size_t padLength = (buffered < 56 ? 56 : 120) - buffered;
+    for (int i = 0; i < 8; i++) {
+        padding[padLength + i] = static_cast<unsigned char>(bitLength >> (56 - 8 * i));
+    }
+    final.update(padding, padLength + 8);
+
+    unsigned char bytes[32];
+    for (int i = 0; i < 8; i++) {
+        bytes[i * 4] = static_cast<unsigned char>(final.state[i] >> 24);
+        bytes[i * 4 + 1] = static_cast<unsigned char>(final.state[i] >> 16);
+        bytes[i * 4 + 2] = static_cast<unsigned char>(final.state[i] >> 8);
+        bytes[i * 4 + 3] = static_cast<unsigned char>(final.state[i]);
+    }
+    return toHex(bytes, sizeof(bytes));
+}
+
+bool hashFile(const fs::path& path, HashAlgorithm algorithm, IoThrottle* throttle,
+              std::string& digest, uint64_t& bytesRead) {
+    if (algorithm == HashAlgorithm::SHA256) {
+        Sha256 hasher;
+        if (!streamFile(path, hasher, throttle, bytesRead)) {
+            return false;
+        }
+        digest = hasher.hexDigest();
+        return true;
+    }
+
+    Xxh64 hasher;
+    if (!streamFile(path, hasher, throttle, bytesRead)) {
+        return false;
+    }
+    digest = hasher.hexDigest();
+    return true;
+}
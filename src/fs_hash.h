@@ -0,0 +1,96 @@
+#pragma once
+
+#include "fs_throttle.h"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+/**
+ * @file fs_hash.h
+ * @brief File hashing for checksum manifests
+ *
+ * Two algorithms are built in: XXH64, a fast non-cryptographic hash that
+ * runs at several GB/s per core and detects accidental corruption, and
+ * SHA-256 for manifests that must also resist deliberate tampering. Both
+ * are streaming, so files are hashed in large blocks without being loaded
+ * into memory.
+ */
+
+enum class HashAlgorithm {
+    XXH64,
+    SHA256
+};
+
+/**
+ * @brief Name of an algorithm as written in manifests ("xxh64", "sha256")
+ */
+const char* hashName(HashAlgorithm algorithm);
+
+/**
+ * @brief Looks up an algorithm by its manifest name
+ *
+ * @return true if the name is known
+ */
+bool parseHashName(const std::string& name, HashAlgorithm& algorithm);
+
+/**
+ * @brief Streaming XXH64
+ */
+class Xxh64 {
+public:
+    explicit Xxh64(uint64_t seed = 0);
+
+    void update(const unsigned char* data, size_t length);
+
+    /**
+     * @brief The digest as 16 lowercase hex digits
+     */
+    std::string hexDigest() const;
+
+private:
+    uint64_t accumulators[4];
+    uint64_t seed;
+    uint64_t totalLength = 0;
+    unsigned char buffer[32];
+    size_t buffered = 0;
+};
+
+/**
+ * @brief Streaming SHA-256
+ */
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const unsigned char* data, size_t length);
+
+    /**
+     * @brief The digest as 64 lowercase hex digits
+     */
+    std::string hexDigest() const;
+
+private:
+    uint32_t state[8];
+    uint64_t totalLength = 0;
+    unsigned char buffer[64];
+    size_t buffered = 0;
+
+    void compress(const unsigned char* block);
+};
+
+/**
+ * @brief Hashes the contents of a file
+ *
+ * The file is read sequentially in 1 MiB blocks with read-ahead hinted to
+ * the kernel, which keeps the disk streaming.
+ *
+ * @param path The file to hash
+ * @param algorithm The hash to compute
+ * @param throttle Paces the bytes read (--nice), or nullptr
+ * @param digest Receives the hex digest
+ * @param bytesRead Receives the number of bytes hashed
+ * @return true if the whole file was read
+ */
+bool hashFile(const std::filesystem::path& path, HashAlgorithm algorithm, IoThrottle* throttle,
+              std::string& digest, uint64_t& bytesRead);
@@ -0,0 +1,226 @@
+/**
+ * @file fs_jump.cpp
+ * @brief Frecency database of visited directories and the `j` jump command
+ *
+ * Every successful `cd` adds to the rank of the target directory and records
+ * the time of the visit. `j <fragment>` then picks the directory with the
+ * best frecency (rank weighted by how recently it was visited) whose path
+ * contains the fragment. The database is a small text file in the state
+ * directory; ranks are aged so that it stays bounded.
+ */
+
+#include "fs.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Once the ranks add up to more than this, they are all scaled down
+ */
+const double MAX_TOTAL_RANK = 5000;
+
+/**
+ * @brief First line of the database; files without it hold unescaped paths
+ */
+const char* DATABASE_HEADER = "optimized_explorer frecency 2";
+
+struct FrecencyEntry {
+    std::string path;
+    double rank;
+    int64_t lastVisit;  // Seconds since the Unix epoch
+};
+
+fs::path databasePath() {
+    return getStateDirectory() / "frecency";
+}
+
+int64_t secondsNow() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Reads the database; lines are "rank<TAB>last visit<TAB>path"
+ */
+std::vector<FrecencyEntry> loadDatabase() {
+    std::vector<FrecencyEntry> entries;
+    std::ifstream in(databasePath());
+    std::string line;
+    bool escaped = false;
+    while (std::getline(in, line)) {
+        if (entries.empty() && line == DATABASE_HEADER) {
+            escaped = true;
+            continue;
+        }
+        size_t firstTab = line.find('\t');
+        size_t secondTab = firstTab == std::string::npos ? std::string::npos : line.find('\t', firstTab + 1);
+        if (secondTab == std::string::npos) {
+            continue;
+        }
+        try {
+            std::string path = line.substr(secondTab + 1);
+            entries.push_back({escaped ? unescapeLine(path) : path,
+                               std::stod(line.substr(0, firstTab)),
+                               std::stoll(line.substr(firstTab + 1, secondTab - firstTab - 1))});
+        } catch (...) {
+            continue;
+        }
+    }
+    return entries;
+}
+
+void saveDatabase(const std::vector<FrecencyEntry>& entries) {
+    std::error_code ec;
+    fs::path target = databasePath();
+    fs::create_directories(target.parent_path(), ec);
+
+    // Write a temporary file and rename it, so a crash never truncates the database
+    fs::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) {
+            return;
+        }
+        out << DATABASE_HEADER << "\n";
+        for (const auto& entry : entries) {
+            out << entry.rank << "\t" << entry.lastVisit << "\t" << escapeLine(entry.path) << "\n";
+        }
+        if (!out.flush()) {
+            return;
+        }
+    }
+    fs::rename(temporary, target, ec);
+}
+
+/**
+ * @brief Rank weighted by the age of the last visit
+ */
+double frecency(const FrecencyEntry& entry, int64_t now) {
+    int64_t age = now - entry.lastVisit;
+    if (age < 3600) {
+        return entry.rank * 4;
+    }
+    if (age < 86400) {
+        return entry.rank * 2;
+    }
+    if (age < 604800) {
+        return entry.rank / 2;
+    }
+    return entry.rank / 4;
+}
+
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+/**
+ * @brief Checks that all words occur in the path, in order, ignoring case
+ */
+bool matchesWords(const std::string& path, const std::vector<std::string>& words) {
+    std::string lowerPath = toLower(path);
+    size_t position = 0;
+    for (const auto& word : words) {
+        position = lowerPath.find(word, position);
+        if (position == std::string::npos) {
+            return false;
+        }
+        position += word.size();
+    }
+    return true;
+}
+
+} // namespace
+
+void recordDirectoryVisit(const std::string& directory) {
+    // Reload before every update so several running explorers do not
+    // overwrite each other's visits
+    std::vector<FrecencyEntry> entries = loadDatabase();
+    int64_t now = secondsNow();
+
+    auto existing = std::find_if(entries.begin(), entries.end(),
+                                 [&](const FrecencyEntry& entry) { return entry.path == directory; });
+    if (existing != entries.end()) {
+        existing->rank += 1;
+        existing->lastVisit = now;
+    } else {
+        entries.push_back({directory, 1, now});
+    }
+
+    double total = 0;
+    for (const auto& entry : entries) {
+        total += entry.rank;
+    }
+    if (total > MAX_TOTAL_RANK) {
+        for (auto& entry : entries) {
+            entry.rank *= 0.9;
+        }
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [](const FrecencyEntry& entry) { return entry.rank < 1; }),
+                      entries.end());
+    }
+
+    saveDatabase(entries);
+}
+
+bool fsJump(const std::string& fragment) {
+    try {
+        std::vector<FrecencyEntry> entries = loadDatabase();
+        int64_t now = secondsNow();
+
+        std::vector<std::string> words;
+        std::istringstream wordStream(toLower(fragment));
+        for (std::string word; wordStream >> word;) {
+            words.push_back(word);
+        }
+
+        std::vector<std::pair<double, const FrecencyEntry*>> ranked;
+        for (const auto& entry : entries) {
+            if (matchesWords(entry.path, words)) {
+                ranked.push_back({frecency(entry, now), &entry});
+            }
+        }
+        std::sort(ranked.begin(), ranked.end(),
+                  [](const auto& a, const auto& b) { return a.first > b.first; });
+
+        // Without a fragment, show the best candidates instead of jumping
+        if (words.empty()) {
+            if (ranked.empty()) {
+                std::cout << "No directories visited yet\n";
+            }
+            for (size_t i = 0; i < ranked.size() && i < 10; i++) {
+                std::ostringstream score;
+                score << std::fixed << std::setprecision(1) << ranked[i].first;
+                std::cout << std::setw(8) << score.str() << "  " << ranked[i].second->path << "\n";
+            }
+            return true;
+        }
+
+        // Skip directories that no longer exist
+        for (const auto& [score, entry] : ranked) {
+            std::error_code ec;
+            if (fs::is_directory(entry->path, ec)) {
+                return fsCd(entry->path);
+            }
+        }
+
+        std::cerr << "Error: No visited directory matches '" << fragment << "'\n";
+        return false;
+    } catch (const std::exception& e) {
+        std::cerr << "Error jumping to directory: " << e.what() << "\n";
+        return false;
+    }
+}
@@ -0,0 +1,542 @@
+/**
+ * @file fs_lineedit.cpp
+ * @brief Implementation of the interactive line editor and Tab completion
+ *
+ * Completion works on the word before the cursor. The first word of a line
+ * is completed against the command names, any later word as a path. For a
+ * path, the directory part is resolved like the commands do (relative to
+ * the current directory, ~ for home) and the rest is looked up in the prefix
+ * trie of that directory. Tries are kept for the most recently completed
+ * directories and thrown away when the shared tree reports a change to
+ * that directory.
+ */
+
+#include "fs_lineedit.h"
+#include "fs.h"
+#include "fs_tree.h"
+#include "fs_trie.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#define OPTIMIZED_EXPLORER_RAW_TERMINAL 1
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const std::vector<std::string> COMMAND_NAMES = {
+    "cache", "cd", "display", "exit", "help", "j", "manifest", "mkdir",
+    "mv", "nice", "quit", "rm", "search", "top", "touch"
+};
+
+const size_t TRIE_CACHE_SIZE = 8;
+const size_t MAX_LISTED_CANDIDATES = 200;
+
+/**
+ * @brief A completion trie together with what it was built from
+ */
+struct CachedTrie {
+    FsTree::NodeId node;
+    uint64_t generation;
+    uint64_t lastUse;
+    PrefixTrie trie;
+};
+
+std::vector<CachedTrie> trieCache;
+uint64_t trieUseCounter = 0;
+std::vector<std::string> history;
+
+/**
+ * @brief Returns the completion trie for a directory, building it if needed
+ *
+ * @return nullptr if the directory cannot be read
+ */
+const PrefixTrie* trieForDirectory(const fs::path& directory) {
+    FsTree& tree = fileTree();
+
+    // Only touch the disk for directories the tree has not listed yet
+    FsTree::NodeId node = tree.find(directory);
+    if (node == FsTree::INVALID_NODE || !tree.isListed(node)) {
+        std::error_code ec;
+        if (!fs::is_directory(directory, ec)) {
+            return nullptr;
+        }
+        node = tree.locate(directory);
+    }
+
+    uint64_t generation = tree.generation(node);
+    for (auto& cached : trieCache) {
+        if (cached.node == node && cached.generation == generation) {
+            cached.lastUse = ++trieUseCounter;
+            return &cached.trie;
+        }
+    }
+
+    std::vector<FsTree::Entry> entries;
+    std::error_code ec;
+    tree.list(node, entries, ec);
+    if (ec && entries.empty()) {
+        return nullptr;
+    }
+
+    std::vector<PrefixTrie::Item> items;
+    items.reserve(entries.size());
+    for (auto& entry : entries) {
+        items.push_back({std::move(entry.name), entry.isDirectory});
+    }
+
+    // Replace the least recently used trie once the cache is full
+    CachedTrie* slot;
+    if (trieCache.size() < TRIE_CACHE_SIZE) {
+        trieCache.emplace_back();
+        slot = &trieCache.back();
+    } else {
+        slot = &*std::min_element(trieCache.begin(), trieCache.end(),
+                                  [](const CachedTrie& a, const CachedTrie& b) {
+                                      return a.lastUse < b.lastUse;
+                                  });
+    }
+    slot->node = node;
+    // Taken after listing, which may itself change the directory's generation
+    slot->generation = tree.generation(node);
+    slot->lastUse = ++trieUseCounter;
+    slot->trie = PrefixTrie(std::move(items));
+    return &slot->trie;
+}
+
+/**
+ * @brief Resolves the directory part of a word being completed
+ */
+fs::path resolveDirectory(const std::string& directoryPart) {
+    if (!directoryPart.empty() && directoryPart[0] == '~') {
+        return fs::path(getHomeDirectory()) / fs::path(directoryPart.substr(1)).relative_path();
+    }
+    fs::path path(directoryPart);
+    if (path.is_absolute()) {
+        return path;
+    }
+    return fs::path(getCurrentDirectory()) / path;
+}
+
+/**
+ * @brief Completes the word that ends at the cursor
+ *
+ * @param line The line being edited
+ * @param cursor Cursor position, moved past the inserted text
+ * @param candidates Receives the possible completions when they share
+ *                   nothing beyond what is already typed
+ * @return true if the line was changed
+ */
+bool completeWord(std::string& line, size_t& cursor, std::vector<std::string>& candidates) {
+    candidates.clear();
+
+    // A word ends at a space outside double quotes, like in splitArguments
+    size_t start = 0;
+    bool inQuotes = false;
+    bool quoted = false;
+    for (size_t i = 0; i < cursor; i++) {
+        if (line[i] == '"') {
+            inQuotes = !inQuotes;
+            quoted = true;
+        } else if (line[i] == ' ' && !inQuotes) {
+            start = i + 1;
+            quoted = false;
+        }
+    }
+    std::string word;
+    for (size_t i = start; i < cursor; i++) {
+        if (line[i] != '"') {
+            word += line[i];
+        }
+    }
+
+    bool isCommand = line.find_first_not_of(' ') >= start;
+    std::string replacement;
+
+    if (isCommand) {
+        std::vector<std::string> matches;
+        for (const auto& name : COMMAND_NAMES) {
+            if (name.compare(0, word.size(), word) == 0) {
+                matches.push_back(name);
+            }
+        }
+        if (matches.size() == 1) {
+            replacement = matches[0] + " ";
+        } else {
+            candidates = matches;
+        }
+    } else {
+#ifdef _WIN32
+        size_t separator = word.find_last_of("/\\");
+#else
+        size_t separator = word.find_last_of('/');
+#endif
+        std::string directoryPart = separator == std::string::npos ? "" : word.substr(0, separator + 1);
+        std::string namePart = word.substr(directoryPart.size());
+
+        const PrefixTrie* trie = trieForDirectory(resolveDirectory(directoryPart));
+        size_t begin, end, commonLength;
+        if (!trie || !trie->findPrefix(namePart, begin, end, commonLength)) {
+            return false;
+        }
+
+        const PrefixTrie::Item& first = trie->item(begin);
+        std::string completed;
+        bool finished = false;
+        if (end - begin == 1) {
+            completed = directoryPart + first.name + (first.isDirectory ? "/" : "");
+            finished = !first.isDirectory;
+        } else if (commonLength > namePart.size()) {
+            completed = directoryPart + first.name.substr(0, commonLength);
+        } else {
+            for (size_t i = begin; i < end && candidates.size() < MAX_LISTED_CANDIDATES; i++) {
+                const PrefixTrie::Item& item = trie->item(i);
+                candidates.push_back(item.name + (item.isDirectory ? "/" : ""));
+            }
+            if (end - begin > MAX_LISTED_CANDIDATES) {
+                candidates.push_back("... and " + std::to_string(end - begin - MAX_LISTED_CANDIDATES) + " more");
+            }
+        }
+
+        if (!completed.empty()) {
+            // Paths with spaces are quoted so they stay one argument; the
+            // quote is left open until the path is complete, so the next
+            // Tab continues inside it
+            bool needsQuotes = quoted || completed.find(' ') != std::string::npos;
+            replacement = needsQuotes ? "\"" + completed : completed;
+            if (finished) {
+                replacement += needsQuotes ? "\" " : " ";
+            }
+        }
+    }
+
+    if (replacement.empty() || line.compare(start, cursor - start, replacement) == 0) {
+        return false;
+    }
+    line.replace(start, cursor - start, replacement);
+    cursor = start + replacement.size();
+    return true;
+}
+
+#ifdef OPTIMIZED_EXPLORER_RAW_TERMINAL
+
+/**
+ * @brief Puts the terminal into raw mode for as long as it exists
+ */
+class RawTerminal {
+public:
+    RawTerminal() {
+        active = tcgetattr(STDIN_FILENO, &original) == 0;
+        if (!active) {
+            return;
+        }
+        termios raw = original;
+        raw.c_iflag &= ~(ICRNL | IXON);
+        raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+        raw.c_cc[VMIN] = 1;
+        raw.c_cc[VTIME] = 0;
+        active = tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) == 0;
+    }
+
+    ~RawTerminal() {
+        if (active) {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &original);
+        }
+    }
+
+    bool isActive() const {
+        return active;
+    }
+
+private:
+    termios original;
+    bool active;
+};
+
+void writeOut(const std::string& text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t count = write(STDOUT_FILENO, text.data() + written, text.size() - written);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        written += static_cast<size_t>(count);
+    }
+}
+
+/**
+ * @brief Number of terminal columns taken by UTF-8 text
+ */
+size_t columns(const std::string& text, size_t from, size_t to) {
+    size_t count = 0;
+    for (size_t i = from; i < to; i++) {
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool isContinuation(const std::string& text, size_t index) {
+    return index < text.size() && (static_cast<unsigned char>(text[index]) & 0xC0) == 0x80;
+}
+
+void refresh(const std::string& prompt, const std::string& line, size_t cursor) {
+    std::string out = "\r" + prompt + line + "\x1b[K";
+    size_t back = columns(line, cursor, line.size());
+    if (back > 0) {
+        out += "\x1b[" + std::to_string(back) + "D";
+    }
+    writeOut(out);
+}
+
+void printCandidates(const std::vector<std::string>& candidates) {
+    winsize size{};
+    size_t width = (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0) ? size.ws_col : 80;
+
+    size_t longest = 0;
+    for (const auto& candidate : candidates) {
+        longest = std::max(longest, candidate.size());
+    }
+    size_t columnWidth = longest + 2;
+    size_t perRow = std::max<size_t>(1, width / columnWidth);
+
+    std::string out = "\r\n";
+    for (size_t i = 0; i < candidates.size(); i++) {
+        out += candidates[i];
+        if ((i + 1) % perRow == 0 || i + 1 == candidates.size()) {
+            out += "\r\n";
+        } else {
+            out += std::string(columnWidth - candidates[i].size(), ' ');
+        }
+    }
+    writeOut(out);
+}
+
+/**
+ * @brief Reads one byte, retrying after signals
+ *
+ * @return false at end of input or on error
+ */
+bool readByte(unsigned char& c) {
+    while (true) {
+        ssize_t count = read(STDIN_FILENO, &c, 1);
+        if (count == 1) {
+            return true;
+        }
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+bool editLine(const std::string& prompt, std::string& line) {
+    line.clear();
+    size_t cursor = 0;
+    size_t historyIndex = history.size();
+    std::string draft;
+    bool lastWasTab = false;
+    std::vector<std::string> candidates;
+
+    writeOut(prompt);
+    while (true) {
+        unsigned char c;
+        if (!readByte(c)) {
+            return false;
+        }
+        bool isTab = false;
+
+        switch (c) {
+        case '\r':
+        case '\n':
+            writeOut("\r\n");
+            if (!line.empty() && (history.empty() || history.back() != line)) {
+                history.push_back(line);
+            }
+            return true;
+
+        case 3: // Ctrl-C abandons the line
+            writeOut("^C\r\n");
+            line.clear();
+            cursor = 0;
+            historyIndex = history.size();
+            writeOut(prompt);
+            break;
+
+        case 4: // Ctrl-D: end of input on an empty line, else delete
+            if (line.empty()) {
+                writeOut("\r\n");
+                return false;
+            }
+            if (cursor < line.size()) {
+                size_t next = cursor + 1;
+                while (isContinuation(line, next)) {
+                    next++;
+                }
+                line.erase(cursor, next - cursor);
+            }
+            break;
+
+        case 1: // Ctrl-A
+            cursor = 0;
+            break;
+
+        case 5: // Ctrl-E
+            cursor = line.size();
+            break;
+
+        case 11: // Ctrl-K
+            line.erase(cursor);
+            break;
+
+        case 21: // Ctrl-U
+            line.erase(0, cursor);
+            cursor = 0;
+            break;
+
+        case 8:
+        case 127: // Backspace
+            if (cursor > 0) {
+                size_t previous = cursor - 1;
+                while (previous > 0 && isContinuation(line, previous)) {
+                    previous--;
+                }
+                line.erase(previous, cursor - previous);
+                cursor = previous;
+            }
+            break;
+
+        case '\t': {
+            isTab = true;
+            if (completeWord(line, cursor, candidates)) {
+                break;
+            }
+            // Like a shell: ring the bell first, list on the second Tab
+            if (candidates.empty() || !lastWasTab) {
+                writeOut("\a");
+            } else {
+                printCandidates(candidates);
+            }
+            break;
+        }
+
+        case 27: { // Escape sequences for cursor keys
+            unsigned char first, second;
+            if (!readByte(first) || !readByte(second) || (first != '[' && first != 'O')) {
+                break;
+            }
+            if (second >= '0' && second <= '9') {
+                unsigned char tilde;
+                if (!readByte(tilde) || tilde != '~') {
+                    break;
+                }
+                if (second == '3' && cursor < line.size()) { // Delete
+                    size_t next = cursor + 1;
+                    while (isContinuation(line, next)) {
+                        next++;
+                    }
+                    line.erase(cursor, next - cursor);
+                } else if (second == '1' || second == '7') {
+                    cursor = 0;
+                } else if (second == '4' || second == '8') {
+                    cursor = line.size();
+                }
+                break;
+            }
+            switch (second) {
+            case 'A': // Up
+                if (historyIndex > 0) {
+                    if (historyIndex == history.size()) {
+                        draft = line;
+                    }
+                    line = history[--historyIndex];
+                    cursor = line.size();
+                }
+                break;
+            case 'B': // Down
+                if (historyIndex < history.size()) {
+                    historyIndex++;
+                    line = historyIndex == history.size() ? draft : history[historyIndex];
+                    cursor = line.size();
+                }
+                break;
+            case 'C': // Right
+                if (cursor < line.size()) {
+                    cursor++;
+                    while (isContinuation(line, cursor)) {
+                        cursor++;
+                    }
+                }
+                break;
+            case 'D': // Left
+                if (cursor > 0) {
+                    cursor--;
+                    while (cursor > 0 && isContinuation(line, cursor)) {
+                        cursor--;
+                    }
+                }
+                break;
+            case 'H':
+                cursor = 0;
+                break;
+            case 'F':
+                cursor = line.size();
+                break;
+            }
+            break;
+        }
+
+        default:
+            if (c >= 32) {
+                line.insert(line.begin() + static_cast<std::ptrdiff_t>(cursor), static_cast<char>(c));
+                cursor++;
+            }
+            break;
+        }
+
+        lastWasTab = isTab;
+        refresh(prompt, line, cursor);
+    }
+}
+
+#endif
+
+} // namespace
+
+void prepareCompletion(const std::string& directory) {
+#ifdef OPTIMIZED_EXPLORER_RAW_TERMINAL
+    // Only an interactive session will ever press Tab
+    if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) {
+        trieForDirectory(fs::path(directory));
+    }
+#else
+    (void)directory;
+#endif
+}
+
+bool readCommandLine(const std::string& prompt, std::string& line) {
+#ifdef OPTIMIZED_EXPLORER_RAW_TERMINAL
+    if (isatty(STDIN_FILENO) && isatty(STDOUT_FILENO)) {
+        std::cout << std::flush;
+        RawTerminal terminal;
+        if (terminal.isActive()) {
+            return editLine(prompt, line);
+        }
+    }
+#endif
+    std::cout << prompt << std::flush;
+    return static_cast<bool>(std::getline(std::cin, line));
+}
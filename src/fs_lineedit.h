@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @file fs_lineedit.h
+ * @brief Interactive command line input with Tab completion
+ */
+
+/**
+ * @brief Reads one command line from the user
+ *
+ * When standard input is a terminal, the line is edited in raw mode:
+ * arrow keys, Home/End, Backspace/Delete, Ctrl-A/E/U/K, Up/Down for history
+ * and Tab to complete command names and paths. Path completion is answered
+ * from per-directory prefix tries built from the shared directory tree, so
+ * a directory is read at most once however often Tab is pressed. Otherwise
+ * (pipes, files, Windows consoles) the line is read with std::getline.
+ *
+ * @param prompt The prompt to show before the line
+ * @param line Receives the line without the trailing newline
+ * @return false at end of input
+ */
+bool readCommandLine(const std::string& prompt, std::string& line);
+
+/**
+ * @brief Builds the completion trie of a directory ahead of the first Tab
+ *
+ * Called after changing directory, so that completing in a large directory
+ * is fast from the first key press. Does nothing when input is not a terminal.
+ *
+ * @param directory The directory that became current
+ */
+void prepareCompletion(const std::string& directory);
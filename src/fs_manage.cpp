@@ -8,13 +8,97 @@
  */
 
 #include "fs.h"
+#include "fs_throttle.h"
+#include "fs_tree.h"
 #include <iostream>
 #include <filesystem>
 #include <string>
 #include <fstream>
+#include <chrono>
+#include <optional>
+#include <utility>
+#include <vector>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+/**
+ * @brief Removes a file or empty directory, feeding its latency to the throttle
+ */
+bool removeTimed(const fs::path& path, IoThrottle& throttle, std::error_code& ec) {
+    auto started = std::chrono::steady_clock::now();
+    bool removed = fs::remove(path, ec);
+    throttle.recordLatency(std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count());
+    return removed;
+}
+
+/**
+ * @brief Recursive delete for --nice, taking throttle tokens for every step
+ *
+ * Works like fs::remove_all (symbolic links are removed, not followed) but
+ * walks the tree itself so that it can pace the directory reads, unlinks
+ * and freed bytes.
+ *
+ * @return The number of removed items including path itself
+ */
+uintmax_t removeAllThrottled(const fs::path& path, IoThrottle& throttle, std::error_code& ec) {
+    uintmax_t removed = 0;
+
+    // A link to a directory is removed itself, never the directory behind it
+    if (!fs::is_directory(fs::symlink_status(path, ec))) {
+        return !ec && removeTimed(path, throttle, ec) ? 1 : 0;
+    }
+
+    // Post-order with an explicit stack: a directory is removed when it is
+    // seen for the second time, after its contents
+    std::vector<std::pair<fs::path, bool>> directoryStack;
+    directoryStack.push_back({path, false});
+    while (!directoryStack.empty()) {
+        throttle.poll();
+        if (directoryStack.back().second) {
+            fs::path directory = std::move(directoryStack.back().first);
+            directoryStack.pop_back();
+            throttle.acquireEntries(1);
+            if (!removeTimed(directory, throttle, ec)) {
+                return removed;
+            }
+            removed++;
+            continue;
+        }
+        directoryStack.back().second = true;
+        fs::path directory = directoryStack.back().first;
+
+        throttle.acquireDirectory();
+        for (fs::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec)) {
+            std::error_code statusError;
+            fs::file_status status = it->symlink_status(statusError);
+            if (fs::is_directory(status)) {
+                directoryStack.push_back({it->path(), false});
+                continue;
+            }
+
+            // Large directories take a while, so limit changes are picked up
+            // between entries too
+            throttle.poll();
+            uintmax_t size = fs::is_regular_file(status) ? it->file_size(statusError) : 0;
+            throttle.acquireEntries(1);
+            throttle.acquireBytes(statusError ? 0 : size);
+            if (!removeTimed(it->path(), throttle, ec)) {
+                return removed;
+            }
+            removed++;
+        }
+        if (ec) {
+            return removed;
+        }
+    }
+    return removed;
+}
+
+} // namespace
+
 /**
  * @brief Creates a new file or directory at the specified path
  * 
@@ -53,6 +137,7 @@ bool fsCreate(const std::string& path, bool isDirectory) {
                 return false;
             }
             std::cout << "Created directory: " << targetPath.string() << "\n";
+            fileTree().insert(targetPath, true);
         } else {
             // Create parent directories if they don't exist
             if (!targetPath.parent_path().empty()) {
@@ -66,6 +151,7 @@ bool fsCreate(const std::string& path, bool isDirectory) {
             }
             file.close();
             std::cout << "Created file: " << targetPath.string() << "\n";
+            fileTree().insert(targetPath, false);
         }
         return true;
 
@@ -87,9 +173,10 @@ bool fsCreate(const std::string& path, bool isDirectory) {
  * - Provides detailed error messages
  * 
  * @param path The path to the file or directory to delete
+ * @param nice true to rate limit the deletion (--nice)
  * @return bool true if deletion was successful, false if any error occurred
  */
-bool fsDelete(const std::string& path) {
+bool fsDelete(const std::string& path, bool nice) {
     try {
         fs::path targetPath;
         
@@ -114,12 +201,22 @@ bool fsDelete(const std::string& path) {
             return false;
         }
 
-        // Delete the file or directory
+        // Delete the file or directory; the cached subtree is dropped up front
+        // since a failed recursive delete may still have removed part of it
+        fileTree().remove(targetPath);
         std::error_code ec;
         bool isDir = fs::is_directory(targetPath);
+
+        // With --nice the delete is paced by the throttle limits
+        std::optional<IoThrottle> throttle;
+        if (nice) {
+            throttle.emplace(loadThrottleLimits());
+        }
+        IoPriorityGuard priority(throttle && throttle->idlePriority());
         
         if (isDir) {
-            uintmax_t itemCount = fs::remove_all(targetPath, ec);
+            uintmax_t itemCount = throttle ? removeAllThrottled(targetPath, *throttle, ec)
+                                       : fs::remove_all(targetPath, ec);
             if (ec) {
                 std::cerr << "Error: Failed to delete directory '" << targetPath.string() 
                          << "': " << ec.message() << "\n";
@@ -128,6 +225,11 @@ bool fsDelete(const std::string& path) {
             std::cout << "Deleted directory and " << (itemCount - 1) 
                      << " contained items: " << targetPath.string() << "\n";
         } else {
+            if (throttle) {
+                throttle->acquireEntries(1);
+                throttle->acquireBytes(fs::is_regular_file(fs::symlink_status(targetPath))
+                                          ? fs::file_size(targetPath, ec) : 0);
+            }
             if (!fs::remove(targetPath, ec)) {
                 std::cerr << "Error: Failed to delete file '" << targetPath.string() 
                          << "': " << ec.message() << "\n";
@@ -210,6 +312,7 @@ bool fsRename(const std::string& oldPath, const std::string& newPath) {
 
         // Perform the rename
         fs::rename(oldTargetPath, newTargetPath);
+        fileTree().move(oldTargetPath, newTargetPath);
         std::cout << "Renamed '" << oldTargetPath.string() << "' to '" 
                  << newTargetPath.string() << "'\n";
         return true;
@@ -0,0 +1,503 @@
+/**
+ * @file fs_manifest.cpp
+ * @brief Checksum manifests: creating them and verifying a tree against one
+ *
+ * A manifest lists every regular file below a root with its digest, size,
+ * modification time and inode. Files are found with the parallel walker
+ * (with cached listings invalidated first, so the manifest reflects the
+ * disk) and hashed by a pool of threads that each stream whole files in
+ * large blocks.
+ *
+ * A file whose size, modification time and inode all match its manifest
+ * record is taken as unchanged and not read again, both when a manifest is
+ * recreated and when it is verified, unless the verify is run with --full.
+ * Verifying never changes the manifest unless --update is given.
+ */
+
+#include "fs.h"
+#include "fs_hash.h"
+#include "fs_throttle.h"
+#include "fs_tree.h"
+#include "fs_walk.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#elif !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char* MANIFEST_HEADER = "optimized_explorer manifest 1";
+
+/**
+ * @brief What identifies a version of a file without reading it
+ */
+struct FileIdentity {
+    uint64_t size = 0;
+    int64_t mtime = 0;      // Nanoseconds since the Unix epoch
+    uint64_t inode = 0;     // 0 where the platform has none
+
+    bool operator==(const FileIdentity& other) const {
+        return size == other.size && mtime == other.mtime && inode == other.inode;
+    }
+};
+
+struct ManifestRecord {
+    std::string path;       // Relative to the root, with '/' separators
+    std::string digest;
+    FileIdentity identity;
+};
+
+struct Manifest {
+    HashAlgorithm algorithm = HashAlgorithm::XXH64;
+    std::string root;
+    std::vector<ManifestRecord> records;
+};
+
+/**
+ * @brief Running totals of a hashing pass
+ */
+struct HashTotals {
+    std::atomic<uint64_t> hashedFiles{0};
+    std::atomic<uint64_t> hashedBytes{0};
+    std::atomic<uint64_t> skippedFiles{0};
+};
+
+/**
+ * @brief Reads size, modification time and inode of a regular file
+ *
+ * Symbolic links are not followed, matching collectFiles.
+ *
+ * @return true if the path is a regular file and could be examined
+ */
+bool readIdentity(const fs::path& path, FileIdentity& identity) {
+#if defined(__linux__) && defined(STATX_INO)
+    struct statx attributes;
+    if (statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW,
+              STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &attributes) != 0
+        || !S_ISREG(attributes.stx_mode)) {
+        return false;
+    }
+    identity.size = attributes.stx_size;
+    identity.mtime = static_cast<int64_t>(attributes.stx_mtime.tv_sec) * 1000000000
+                   + attributes.stx_mtime.tv_nsec;
+    identity.inode = attributes.stx_ino;
+    return true;
+#elif !defined(_WIN32)
+    struct stat attributes;
+    if (::lstat(path.c_str(), &attributes) != 0 || !S_ISREG(attributes.st_mode)) {
+        return false;
+    }
+    identity.size = static_cast<uint64_t>(attributes.st_size);
+    identity.mtime = static_cast<int64_t>(attributes.st_mtime) * 1000000000;
+    identity.inode = static_cast<uint64_t>(attributes.st_ino);
+    return true;
+#else
+    std::error_code ec;
+    if (!fs::is_regular_file(fs::symlink_status(path, ec))) {
+        return false;
+    }
+    identity.size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto written = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    identity.mtime = written.time_since_epoch().count();
+    identity.inode = 0;
+    return true;
+#endif
+}
+
+/**
+ * @brief Resolves a command line path against the explorer's current directory
+ */
+fs::path resolvePath(const std::string& path) {
+    fs::path input(path);
+    fs::path absolute = input.is_absolute() ? input : fs::path(getCurrentDirectory()) / input;
+    return absolute.lexically_normal();
+}
+
+bool saveManifest(const fs::path& target, const Manifest& manifest) {
+    std::error_code ec;
+    fs::create_directories(target.parent_path(), ec);
+
+    fs::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << MANIFEST_HEADER << "\n"
+            << "algorithm " << hashName(manifest.algorithm) << "\n"
+            << "root " << escapeLine(manifest.root) << "\n";
+        for (const auto& record : manifest.records) {
+            out << record.digest << "\t" << record.identity.size << "\t" << record.identity.mtime << "\t"
+                << record.identity.inode << "\t" << escapeLine(record.path) << "\n";
+        }
+        if (!out.flush()) {
+            return false;
+        }
+    }
+    fs::rename(temporary, target, ec);
+    return !ec;
+}
+
+/**
+ * @brief Reads a manifest; lines are "digest<TAB>size<TAB>mtime<TAB>inode<TAB>path"
+ *
+ * @return false if the file is missing or damaged
+ */
+bool loadManifest(const fs::path& source, Manifest& manifest) {
+    std::ifstream in(source);
+    std::string header, algorithmLine, rootLine;
+    std::getline(in, header);
+    std::getline(in, algorithmLine);
+    std::getline(in, rootLine);
+    if (!in || header != MANIFEST_HEADER
+        || algorithmLine.compare(0, 10, "algorithm ") != 0 || rootLine.compare(0, 5, "root ") != 0
+        || !parseHashName(algorithmLine.substr(10), manifest.algorithm)) {
+        return false;
+    }
+    manifest.root = unescapeLine(rootLine.substr(5));
+    manifest.records.clear();
+
+    std::string line;
+    while (std::getline(in, line)) {
+        // The path comes last, so it may itself contain tabs
+        size_t fields[4];
+        size_t position = 0;
+        for (size_t& field : fields) {
+            field = line.find('\t', position);
+            if (field == std::string::npos) {
+                return false;
+            }
+            position = field + 1;
+        }
+        try {
+            ManifestRecord record;
+            record.digest = line.substr(0, fields[0]);
+            record.identity.size = std::stoull(line.substr(fields[0] + 1, fields[1] - fields[0] - 1));
+            record.identity.mtime = std::stoll(line.substr(fields[1] + 1, fields[2] - fields[1] - 1));
+            record.identity.inode = std::stoull(line.substr(fields[2] + 1, fields[3] - fields[2] - 1));
+            record.path = unescapeLine(line.substr(fields[3] + 1));
+            manifest.records.push_back(std::move(record));
+        } catch (...) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Lists all regular files below root, as sorted relative paths
+ *
+ * Cached listings are invalidated first so that files created or deleted
+ * outside the explorer are seen. Symbolic links, FIFOs, sockets and
+ * devices are skipped.
+ *
+ * @param exclude Absolute paths to leave out (the manifest itself)
+ */
+std::vector<std::string> collectFiles(const fs::path& root, const std::vector<fs::path>& exclude,
+                                      IoThrottle* throttle) {
+    fileTree().invalidate(root, true);
+
+    TreeWalker walker;
+    walker.setThrottle(throttle);
+    std::vector<std::vector<std::string>> found(walker.threadCount());
+    walker.add(root);
+    walker.run([&](unsigned worker, const WalkDirectory& current,
+                   const std::vector<FsTree::Entry>& entries, const std::error_code& ec) {
+        if (ec) {
+            std::cerr << "Warning: Some entries in " << current.path << " could not be accessed\n";
+        }
+        for (const auto& entry : entries) {
+            // Only regular files have contents to hash, as in readIdentity
+            if (entry.isDirectory || entry.isSymlink || entry.isOther) {
+                continue;
+            }
+            fs::path path = current.path / entry.name;
+            if (std::find(exclude.begin(), exclude.end(), path) != exclude.end()) {
+                continue;
+            }
+            found[worker].push_back(path.lexically_relative(root).generic_string());
+        }
+    });
+
+    std::vector<std::string> files;
+    for (auto& paths : found) {
+        files.insert(files.end(), std::make_move_iterator(paths.begin()), std::make_move_iterator(paths.end()));
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+/**
+ * @brief Runs task(index) for every index below count on a pool of threads
+ *
+ * Hashing is CPU bound for SHA-256 and I/O bound for fast hashes on slow
+ * disks, so one thread per core keeps either side busy.
+ */
+template <typename Task>
+void runParallel(size_t count, IoThrottle* throttle, const Task& task) {
+    unsigned threads = std::clamp(std::thread::hardware_concurrency(), 2u, 16u);
+    std::atomic<size_t> next{0};
+    auto work = [&]() {
+        IoPriorityGuard priority(throttle && throttle->idlePriority());
+        for (size_t index = next++; index < count; index = next++) {
+            if (throttle) {
+                throttle->poll();
+            }
+            task(index);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned worker = 1; worker < threads; worker++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void printThroughput(const HashTotals& totals, std::chrono::steady_clock::time_point started) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    double mebibytes = static_cast<double>(totals.hashedBytes) / (1024 * 1024);
+    std::ostringstream out;
+    out << "Hashed " << totals.hashedFiles << " files (" << std::fixed << std::setprecision(1)
+        << mebibytes << " MiB) in " << seconds << " s";
+    if (seconds > 0) {
+        out << ", " << mebibytes / seconds << " MiB/s";
+    }
+    out << "; " << totals.skippedFiles << " unchanged files not reread\n";
+    std::cout << out.str();
+}
+
+} // namespace
+
+bool fsManifestCreate(const std::string& directory, const std::string& manifestPath, bool sha256, bool nice) {
+    try {
+        fs::path root = resolvePath(directory);
+        fs::path target = resolvePath(manifestPath);
+        if (!fs::is_directory(root)) {
+            std::cerr << "Error: '" << root.string() << "' is not a directory\n";
+            return false;
+        }
+
+        Manifest manifest;
+        manifest.algorithm = sha256 ? HashAlgorithm::SHA256 : HashAlgorithm::XXH64;
+        manifest.root = root.string();
+
+        // An earlier manifest of the same tree lets unchanged files keep their digests
+        Manifest previous;
+        std::unordered_map<std::string, const ManifestRecord*> known;
+        if (loadManifest(target, previous) && previous.root == manifest.root
+            && previous.algorithm == manifest.algorithm) {
+            for (const auto& record : previous.records) {
+                known.emplace(record.path, &record);
+            }
+        }
+
+        std::optional<IoThrottle> throttle;
+        if (nice) {
+            throttle.emplace(loadThrottleLimits());
+        }
+        IoThrottle* pacing = throttle ? &*throttle : nullptr;
+
+        std::cout << "Creating " << hashName(manifest.algorithm) << " manifest of: " << root.string() << "\n";
+        auto started = std::chrono::steady_clock::now();
+        fs::path temporary = target;
+        temporary += ".tmp";
+        std::vector<std::string> files = collectFiles(root, {target, temporary}, pacing);
+
+        manifest.records.resize(files.size());
+        std::vector<char> readable(files.size(), 0);
+        HashTotals totals;
+        std::mutex outputMutex;
+
+        runParallel(files.size(), pacing, [&](size_t index) {
+            ManifestRecord& record = manifest.records[index];
+            record.path = files[index];
+            fs::path path = root / fs::path(record.path);
+
+            if (!readIdentity(path, record.identity)) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "Warning: Could not read " << path.string() << "\n";
+                return;
+            }
+            auto it = known.find(record.path);
+            if (it != known.end() && it->second->identity == record.identity) {
+                record.digest = it->second->digest;
+                readable[index] = 1;
+                totals.skippedFiles++;
+                return;
+            }
+
+            uint64_t bytesRead = 0;
+            if (!hashFile(path, manifest.algorithm, pacing, record.digest, bytesRead)) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "Warning: Could not read " << path.string() << "\n";
+                return;
+            }
+            readable[index] = 1;
+            totals.hashedFiles++;
+            totals.hashedBytes += bytesRead;
+        });
+
+        // Files that vanished or could not be read are left out
+        size_t kept = 0;
+        for (size_t index = 0; index < files.size(); index++) {
+            if (!readable[index]) {
+                continue;
+            }
+            if (kept != index) {
+                manifest.records[kept] = std::move(manifest.records[index]);
+            }
+            kept++;
+        }
+        manifest.records.resize(kept);
+
+        if (!saveManifest(target, manifest)) {
+            std::cerr << "Error: Could not write manifest '" << target.string() << "'\n";
+            return false;
+        }
+
+        printThroughput(totals, started);
+        std::cout << "Wrote " << manifest.records.size() << " entries to: " << target.string() << "\n";
+        return kept == files.size();
+    } catch (const std::exception& e) {
+        std::cerr << "Error creating manifest: " << e.what() << "\n";
+        return false;
+    }
+}
+
+bool fsManifestVerify(const std::string& manifestPath, bool full, bool update, bool nice) {
+    try {
+        fs::path source = resolvePath(manifestPath);
+        Manifest manifest;
+        if (!loadManifest(source, manifest)) {
+            std::cerr << "Error: '" << source.string() << "' is missing or not a valid manifest\n";
+            return false;
+        }
+        fs::path root(manifest.root);
+        if (!fs::is_directory(root)) {
+            std::cerr << "Error: The manifest root '" << manifest.root << "' is not a directory\n";
+            return false;
+        }
+
+        std::optional<IoThrottle> throttle;
+        if (nice) {
+            throttle.emplace(loadThrottleLimits());
+        }
+        IoThrottle* pacing = throttle ? &*throttle : nullptr;
+
+        std::cout << "Verifying " << hashName(manifest.algorithm) << " manifest of: " << manifest.root << "\n";
+        auto started = std::chrono::steady_clock::now();
+        fs::path temporary = source;
+        temporary += ".tmp";
+        std::vector<std::string> files = collectFiles(root, {source, temporary}, pacing);
+
+        enum : char { MATCHES, MODIFIED, MISSING, UNREADABLE, NOT_A_FILE };
+        std::vector<char> results(manifest.records.size(), MATCHES);
+        std::atomic<bool> identitiesChanged{false};
+        HashTotals totals;
+
+        runParallel(manifest.records.size(), pacing, [&](size_t index) {
+            ManifestRecord& record = manifest.records[index];
+            fs::path path = root / fs::path(record.path);
+
+            FileIdentity identity;
+            if (!readIdentity(path, identity)) {
+                std::error_code ec;
+                fs::file_status status = fs::symlink_status(path, ec);
+                if (!fs::exists(status)) {
+                    results[index] = MISSING;
+                } else {
+                    // E.g. replaced by a symbolic link, which is not followed
+                    results[index] = fs::is_regular_file(status) ? UNREADABLE : NOT_A_FILE;
+                }
+                return;
+            }
+            if (!full && identity == record.identity) {
+                totals.skippedFiles++;
+                return;
+            }
+
+            std::string digest;
+            uint64_t bytesRead = 0;
+            if (!hashFile(path, manifest.algorithm, pacing, digest, bytesRead)) {
+                results[index] = UNREADABLE;
+                return;
+            }
+            totals.hashedFiles++;
+            totals.hashedBytes += bytesRead;
+            if (digest != record.digest) {
+                results[index] = MODIFIED;
+            } else if (update && !(identity == record.identity)) {
+                // Same content under new metadata (touched, copied back):
+                // remember it so the next verify can skip the file
+                record.identity = identity;
+                identitiesChanged = true;
+            }
+        });
+
+        size_t problems = 0;
+        const char* labels[] = {"", "[MODIFIED] ", "[MISSING] ", "[UNREADABLE] ", "[NOT A FILE] "};
+        for (size_t index = 0; index < manifest.records.size(); index++) {
+            if (results[index] != MATCHES) {
+                std::cout << labels[static_cast<int>(results[index])] << manifest.records[index].path << "\n";
+                problems++;
+            }
+        }
+
+        // Files in the tree the manifest does not know about (both lists are sorted)
+        std::vector<std::string> recorded;
+        recorded.reserve(manifest.records.size());
+        for (const auto& record : manifest.records) {
+            recorded.push_back(record.path);
+        }
+        std::sort(recorded.begin(), recorded.end());
+        std::vector<std::string> added;
+        std::set_difference(files.begin(), files.end(), recorded.begin(), recorded.end(),
+                            std::back_inserter(added));
+        for (const auto& path : added) {
+            std::cout << "[NEW] " << path << "\n";
+        }
+        problems += added.size();
+
+        if (identitiesChanged && !saveManifest(source, manifest)) {
+            std::cerr << "Warning: Could not update file metadata in '" << source.string() << "'\n";
+        }
+
+        printThroughput(totals, started);
+        if (problems == 0) {
+            std::cout << "All " << manifest.records.size() << " files match the manifest\n";
+        } else {
+            std::cout << problems << " of " << manifest.records.size() + added.size()
+                      << " files differ from the manifest\n";
+        }
+        return problems == 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error verifying manifest: " << e.what() << "\n";
+        return false;
+    }
+}
@@ -1,13 +1,27 @@
 #include "fs.h"
+#include "fs_checkpoint.h"
+#include "fs_throttle.h"
+#include "fs_tree.h"
+#include "fs_walk.h"
 #include <iostream>
 #include <filesystem>
 #include <string>
-#include <stack>
 #include <vector>
 #include <algorithm>
+#include <mutex>
+#include <optional>
 
 namespace fs = std::filesystem;
 
+namespace {
+
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), ::tolower);
+    return text;
+}
+
+} // namespace
+
 /**
  * @brief Checks if a filename matches the search term
  * 
@@ -19,22 +33,28 @@ namespace fs = std::filesystem;
  * @return true if the filename contains the search term, false otherwise
  */
 bool matchesSearch(const std::string& fileName, const std::string& searchTerm) {
-    std::string lowerFileName = fileName;
-    std::string lowerSearchTerm = searchTerm;
-    
     // Convert both strings to lowercase for case-insensitive comparison
-    std::transform(lowerFileName.begin(), lowerFileName.end(), lowerFileName.begin(), ::tolower);
-    std::transform(lowerSearchTerm.begin(), lowerSearchTerm.end(), lowerSearchTerm.begin(), ::tolower);
-    
-    return lowerFileName.find(lowerSearchTerm) != std::string::npos;
+    return toLower(fileName).find(toLower(searchTerm)) != std::string::npos;
 }
 
-void fsSearch(const std::string& directory) {
+void fsSearch(const std::string& directory, bool resume, bool sameDevice, bool nice) {
     try {
-        // Get search term from user
-        std::cout << "Enter search term: ";
+        TraversalCheckpoint checkpoint;
         std::string searchTerm;
-        std::getline(std::cin, searchTerm);
+        std::string root = directory;
+
+        if (resume) {
+            // Continue where the interrupted search stopped
+            if (!loadCheckpoint("search", directory, checkpoint)) {
+                return;
+            }
+            root = checkpoint.root;
+            searchTerm = checkpoint.term;
+        } else {
+            // Get search term from user
+            std::cout << "Enter search term: ";
+            std::getline(std::cin, searchTerm);
+        }
         
         // Validate search term
         if (searchTerm.empty()) {
@@ -43,75 +63,110 @@ void fsSearch(const std::string& directory) {
         }
 
         // Validate directory
-        if (!fs::exists(directory)) {
-            std::cerr << "Error: The path '" << directory << "' does not exist.\n";
+        if (!fs::exists(root)) {
+            std::cerr << "Error: The path '" << root << "' does not exist.\n";
             return;
         }
 
-        std::cout << "Searching for '" << searchTerm << "' in: " << directory << "\n";
+        std::cout << (resume ? "Resuming search for '" : "Searching for '")
+                  << searchTerm << "' in: " << root << "\n";
         
         // Handle single file case
-        if (!fs::is_directory(directory)) {
-            if (matchesSearch(fs::path(directory).filename().string(), searchTerm)) {
-                std::cout << "[FILE] " << fs::absolute(directory).string() << "\n";
+        if (!fs::is_directory(root)) {
+            if (matchesSearch(fs::path(root).filename().string(), searchTerm)) {
+                std::cout << "[FILE] " << fs::absolute(root).string() << "\n";
             }
             return;
         }
 
-        // Initialize directory traversal
-        std::stack<fs::path> directoryStack;
-        directoryStack.push(fs::path(directory));
-        int matchCount = 0;
+        // Directories are listed in parallel through the shared tree, so
+        // directories listed by an earlier command are not read from disk
+        // again; each device gets its own queue so slow mounts do not hold
+        // up fast ones
+        TreeWalker walker;
+        std::mutex outputMutex;
 
-        // Process directories in a depth-first manner
-        while (!directoryStack.empty()) {
-            auto currentDir = directoryStack.top();
-            directoryStack.pop();
+        if (resume) {
+            for (const auto& pending : checkpoint.pending) {
+                walker.add(fs::path(pending));
+            }
+            walker.setResults(checkpoint.results);
+            sameDevice = checkpoint.sameDevice;
+        } else {
+            walker.add(fs::path(root));
+            checkpoint.command = "search";
+            checkpoint.root = fs::absolute(root).lexically_normal().string();
+            checkpoint.term = searchTerm;
+            checkpoint.sameDevice = sameDevice;
+        }
+        walker.setSameDevice(sameDevice);
 
-            try {
-                // Skip system directories
-                if (shouldSkipPath(currentDir.string())) {
-                    continue;
-                }
+        // --nice paces disk reads; the limits can change while it runs
+        std::optional<IoThrottle> throttle;
+        if (nice) {
+            throttle.emplace(loadThrottleLimits());
+            walker.setThrottle(&*throttle);
+        }
+
+        // Save the frontier every few seconds and when interrupted; matches
+        // are counted through the walker, so the count always belongs to the
+        // saved frontier
+        CheckpointSchedule schedule;
+        InterruptGuard interrupt;
+        auto recordCheckpoint = [&](const std::vector<fs::path>& pending, uint64_t results) {
+            checkpoint.results = results;
+            checkpoint.pending.clear();
+            for (const auto& path : pending) {
+                checkpoint.pending.push_back(fs::absolute(path).string());
+            }
+            saveCheckpoint(checkpoint);
+        };
 
-                // Configure directory iterator options
-                const auto dirOptions = fs::directory_options::skip_permission_denied;
-                std::error_code errorCode;
-                
-                // Iterate through directory contents
-                for (const auto& entry : fs::directory_iterator(currentDir, dirOptions, errorCode)) {
-                    try {
-                        const auto& entryPath = entry.path();
-                        
-                        // Skip system files and directories
-                        if (shouldSkipPath(entryPath.string())) {
-                            continue;
-                        }
-
-                        // Check if current entry matches search criteria
-                        if (matchesSearch(entryPath.filename().string(), searchTerm)) {
-                            std::cout << (fs::is_directory(entryPath, errorCode) ? "[DIR] " : "[FILE] ")
-                                     << entryPath.string() << "\n";
-                            matchCount++;
-                        }
-
-                        // Add subdirectories to the stack for processing
-                        if (fs::is_directory(entryPath, errorCode)) {
-                            directoryStack.push(entryPath);
-                        }
-                    } catch (...) {
-                        // Skip entries that cause errors
-                        continue;
-                    }
+        std::string lowerSearchTerm = toLower(searchTerm);
+        walker.run([&](unsigned worker, const WalkDirectory& current,
+                       const std::vector<FsTree::Entry>& entries, const std::error_code&) {
+            // Collect the matches of a directory first and print them in one
+            // go, so lines from different workers do not interleave
+            std::string output;
+            uint64_t matches = 0;
+            for (const auto& entry : entries) {
+                if (toLower(entry.name).find(lowerSearchTerm) != std::string::npos) {
+                    output += entry.isDirectory ? "[DIR] " : "[FILE] ";
+                    output += (current.path / entry.name).string();
+                    output += "\n";
+                    matches++;
                 }
-            } catch (...) {
-                // Skip directories that cause errors
-                continue;
             }
+            if (matches > 0) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cout << output;
+                walker.countResults(worker, matches);
+            }
+        }, [&]() {
+            if (interrupt.interrupted()) {
+                return false;
+            }
+            if (throttle) {
+                throttle->poll();
+            }
+            if (schedule.due()) {
+                walker.snapshot(recordCheckpoint);
+            }
+            return true;
+        });
+
+        if (interrupt.interrupted()) {
+            recordCheckpoint(walker.remaining(), walker.results());
+            std::cout << "\nSearch interrupted after " << walker.results()
+                      << " matches; continue it with: search --resume\n";
+            return;
         }
+
+        // The search is complete, nothing left to resume
+        discardCheckpoint("search");
         
         // Display search results summary
-        std::cout << "\nFound " << matchCount << " matches for '" << searchTerm << "'\n";
+        std::cout << "\nFound " << walker.results() << " matches for '" << searchTerm << "'\n";
     } catch (const std::exception& e) {
         std::cerr << "Error during search: " << e.what() << "\n";
     }
@@ -0,0 +1,350 @@
+/**
+ * @file fs_throttle.cpp
+ * @brief Implementation of I/O rate limiting for --nice
+ */
+
+#include "fs_throttle.h"
+#include "fs.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Seconds of traffic a bucket may save up for a burst
+ */
+const double BURST_SECONDS = 0.1;
+
+/**
+ * @brief Longest single sleep, so release() is noticed quickly
+ */
+const std::chrono::milliseconds MAX_SLEEP(100);
+
+/**
+ * @brief Latency samples between two backoff decisions
+ */
+const unsigned BACKOFF_INTERVAL = 32;
+
+/**
+ * @brief Latency this far above the baseline counts as contention
+ */
+const double BACKOFF_THRESHOLD = 2.0;
+
+/**
+ * @brief Lowest share of the configured rates backoff goes down to
+ */
+const double MIN_FACTOR = 0.05;
+
+fs::path controlPath() {
+    return getStateDirectory() / "nice";
+}
+
+/**
+ * @brief Parses a rate such as "500", "20M" or "1.5G"
+ */
+bool parseRate(const std::string& text, double& rate) {
+    size_t used = 0;
+    try {
+        rate = std::stod(text, &used);
+    } catch (...) {
+        return false;
+    }
+    std::string suffix = text.substr(used);
+    if (suffix == "K" || suffix == "k") {
+        rate *= 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        rate *= 1024 * 1024;
+    } else if (suffix == "G" || suffix == "g") {
+        rate *= 1024.0 * 1024 * 1024;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    return rate >= 0;
+}
+
+std::string formatRate(double rate, const char* unit) {
+    if (rate <= 0) {
+        return "unlimited";
+    }
+    std::ostringstream out;
+    out << rate << " " << unit << "/s";
+    return out.str();
+}
+
+#if defined(__linux__) && defined(SYS_ioprio_set)
+const int IOPRIO_WHO_PROCESS = 1;
+const int IOPRIO_CLASS_IDLE = 3;
+const int IOPRIO_CLASS_SHIFT = 13;
+#endif
+
+} // namespace
+
+ThrottleLimits loadThrottleLimits() {
+    ThrottleLimits limits;
+    std::ifstream in(controlPath());
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        double value;
+        if (!(fields >> key >> value) || value < 0) {
+            continue;
+        }
+        if (key == "directories") {
+            limits.directories = value;
+        } else if (key == "entries") {
+            limits.entries = value;
+        } else if (key == "bytes") {
+            limits.bytes = value;
+        } else if (key == "idle") {
+            limits.idlePriority = value != 0;
+        }
+    }
+    return limits;
+}
+
+bool saveThrottleLimits(const ThrottleLimits& limits) {
+    std::error_code ec;
+    fs::path target = controlPath();
+    fs::create_directories(target.parent_path(), ec);
+
+    // Replaced atomically, since running commands may read it at any time
+    fs::path temporary = target;
+    temporary += ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << "directories " << limits.directories << "\n"
+            << "entries " << limits.entries << "\n"
+            << "bytes " << static_cast<uint64_t>(limits.bytes) << "\n"
+            << "idle " << (limits.idlePriority ? 1 : 0) << "\n";
+        if (!out.flush()) {
+            return false;
+        }
+    }
+    fs::rename(temporary, target, ec);
+    return !ec;
+}
+
+void TokenBucket::setRate(double newRate) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refill(std::chrono::steady_clock::now());
+    bool first = capacity == 0;
+    rate = newRate;
+    capacity = std::max(1.0, rate * BURST_SECONDS);
+    tokens = first ? capacity : std::min(tokens, capacity);
+}
+
+void TokenBucket::refill(std::chrono::steady_clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - refilled).count();
+    refilled = now;
+    tokens = std::min(capacity, tokens + elapsed * rate);
+}
+
+void TokenBucket::acquire(double amount, const std::atomic<bool>& released) {
+    while (!released) {
+        double wait;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (rate <= 0) {
+                return;
+            }
+            refill(std::chrono::steady_clock::now());
+            if (tokens > 0) {
+                tokens -= amount;
+                return;
+            }
+            wait = std::max(-tokens / rate, 0.001);
+        }
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(wait)),
+            MAX_SLEEP));
+    }
+}
+
+IoThrottle::IoThrottle(const ThrottleLimits& limits) : configured(limits) {
+    std::error_code ec;
+    controlWritten = fs::last_write_time(controlPath(), ec);
+    nextPoll = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    applyRates();
+}
+
+void IoThrottle::setLimits(const ThrottleLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex);
+    configured = limits;
+    applyRates();
+}
+
+bool IoThrottle::idlePriority() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return configured.idlePriority;
+}
+
+void IoThrottle::applyRates() {
+    directories.setRate(configured.directories * factor);
+    entries.setRate(configured.entries * factor);
+    bytes.setRate(configured.bytes * factor);
+}
+
+void IoThrottle::acquireDirectory() {
+    directories.acquire(1, released);
+}
+
+void IoThrottle::acquireEntries(size_t count) {
+    if (count > 0) {
+        entries.acquire(static_cast<double>(count), released);
+    }
+}
+
+void IoThrottle::acquireBytes(uint64_t count) {
+    if (count > 0) {
+        bytes.acquire(static_cast<double>(count), released);
+    }
+}
+
+void IoThrottle::recordLatency(double milliseconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    latency = samples == 0 ? milliseconds : latency * 0.9 + milliseconds * 0.1;
+    samples++;
+    if (samples < BACKOFF_INTERVAL) {
+        return;
+    }
+
+    // The baseline follows the lowest latency seen, and creeps up slowly so
+    // that a lasting change (e.g. a colder cache) is eventually accepted
+    if (baseline == 0 || latency < baseline) {
+        baseline = latency;
+    } else {
+        baseline += (latency - baseline) * 0.001;
+    }
+    if (samples % BACKOFF_INTERVAL != 0) {
+        return;
+    }
+
+    // Back off multiplicatively when the device is contended, recover
+    // additively once latency is back near its baseline
+    if (latency > baseline * BACKOFF_THRESHOLD && latency > 0.5) {
+        factor = std::max(MIN_FACTOR, factor / 2);
+        applyRates();
+    } else if (factor < 1 && latency < baseline * 1.25) {
+        factor = std::min(1.0, factor + 0.05);
+        applyRates();
+    }
+}
+
+void IoThrottle::poll() {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (now < nextPoll) {
+            return;
+        }
+        nextPoll = now + std::chrono::seconds(1);
+    }
+
+    std::error_code ec;
+    auto written = fs::last_write_time(controlPath(), ec);
+    if (ec) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (written == controlWritten) {
+            return;
+        }
+        controlWritten = written;
+    }
+    setLimits(loadThrottleLimits());
+}
+
+void IoThrottle::release() {
+    released = true;
+}
+
+IoPriorityGuard::IoPriorityGuard(bool enable) {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    if (!enable) {
+        return;
+    }
+    // With IOPRIO_WHO_PROCESS, 0 means the calling thread only
+    int current = static_cast<int>(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0));
+    if (current >= 0 &&
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == 0) {
+        previous = current;
+    }
+#else
+    (void)enable;
+#endif
+}
+
+IoPriorityGuard::~IoPriorityGuard() {
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    if (previous >= 0) {
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, previous);
+    }
+#endif
+}
+
+void fsNice(const std::string& settings) {
+    try {
+        ThrottleLimits limits = loadThrottleLimits();
+
+        std::istringstream words(settings);
+        bool changed = false;
+        for (std::string word; words >> word;) {
+            if (word == "reset") {
+                limits = ThrottleLimits();
+                changed = true;
+                continue;
+            }
+
+            size_t equals = word.find('=');
+            std::string name = word.substr(0, equals);
+            std::string value = equals == std::string::npos ? "" : word.substr(equals + 1);
+            bool valid = equals != std::string::npos;
+            if (valid && name == "directories") {
+                valid = parseRate(value, limits.directories);
+            } else if (valid && name == "entries") {
+                valid = parseRate(value, limits.entries);
+            } else if (valid && name == "bytes") {
+                valid = parseRate(value, limits.bytes);
+            } else if (valid && name == "idle") {
+                valid = value == "on" || value == "off";
+                limits.idlePriority = value == "on";
+            } else {
+                valid = false;
+            }
+            if (!valid) {
+                std::cerr << "Error: Invalid setting '" << word << "'\n";
+                return;
+            }
+            changed = true;
+        }
+
+        if (changed && !saveThrottleLimits(limits)) {
+            std::cerr << "Error: Could not save the limits\n";
+            return;
+        }
+
+        std::cout << "Limits for --nice:\n"
+                  << "  directories  " << formatRate(limits.directories, "directories") << "\n"
+                  << "  entries      " << formatRate(limits.entries, "entries") << "\n"
+                  << "  bytes        " << formatRate(limits.bytes / (1024 * 1024), "MiB") << "\n"
+                  << "  idle         " << (limits.idlePriority ? "on" : "off") << "\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error changing limits: " << e.what() << "\n";
+    }
+}
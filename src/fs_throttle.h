@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+
+/**
+ * @file fs_throttle.h
+ * @brief I/O rate limiting for commands run with --nice
+ *
+ * A throttled command takes tokens before every syscall-heavy step: one per
+ * directory read from disk, one per entry, and one per byte of file data it
+ * touches. Each kind has its own token bucket. The limits live in a small
+ * control file in the state directory, which a running command rereads
+ * once a second, so they can be changed while it runs (e.g. with the `nice`
+ * command from another explorer). When the measured syscall latency rises
+ * well above its baseline, all rates are cut back until it recovers.
+ */
+
+/**
+ * @brief Limits for --nice; a rate of 0 means unlimited
+ */
+struct ThrottleLimits {
+    double directories = 100;      // Directories read per second
+    double entries = 10000;        // Entries listed or removed per second
+    double bytes = 64 << 20;       // Bytes of file data per second
+    bool idlePriority = true;      // Use the idle I/O scheduling class
+};
+
+/**
+ * @brief Reads the limits from the control file, or the defaults if it is missing
+ */
+ThrottleLimits loadThrottleLimits();
+
+/**
+ * @brief Writes the limits to the control file, picked up by running commands
+ *
+ * @return true if the file was written
+ */
+bool saveThrottleLimits(const ThrottleLimits& limits);
+
+/**
+ * @brief Thread-safe token bucket
+ *
+ * A request larger than the remaining tokens is granted as soon as the
+ * bucket is not in debt, and the debt is paid off by later requests, so
+ * one huge directory or file never blocks forever.
+ */
+class TokenBucket {
+public:
+    /**
+     * @param rate Tokens per second, 0 for unlimited
+     */
+    void setRate(double rate);
+
+    /**
+     * @brief Takes tokens, sleeping while the bucket is in debt
+     *
+     * @param released Waiting stops early once this is set
+     */
+    void acquire(double amount, const std::atomic<bool>& released);
+
+private:
+    double rate = 0;
+    double capacity = 0;
+    double tokens = 0;
+    std::chrono::steady_clock::time_point refilled = std::chrono::steady_clock::now();
+    std::mutex mutex;
+
+    void refill(std::chrono::steady_clock::time_point now);
+};
+
+class IoThrottle {
+public:
+    explicit IoThrottle(const ThrottleLimits& limits);
+
+    /**
+     * @brief Replaces the configured limits; takes effect immediately
+     */
+    void setLimits(const ThrottleLimits& limits);
+
+    bool idlePriority();
+
+    void acquireDirectory();
+    void acquireEntries(size_t count);
+    void acquireBytes(uint64_t count);
+
+    /**
+     * @brief Feeds the latency of one syscall into the adaptive backoff
+     *
+     * Directory listings should be split into their getdents calls, or
+     * large directories look like a busy disk.
+     */
+    void recordLatency(double milliseconds);
+
+    /**
+     * @brief Rereads the control file if it changed; cheap enough to call often
+     */
+    void poll();
+
+    /**
+     * @brief Lets all current and future waits return at once (e.g. on Ctrl-C)
+     */
+    void release();
+
+private:
+    ThrottleLimits configured;
+    double factor = 1;            // Share of the configured rates in use, lowered by backoff
+    double latency = 0;           // Average syscall latency in ms
+    double baseline = 0;          // Lowest average latency seen
+    unsigned samples = 0;
+    std::filesystem::file_time_type controlWritten;
+    std::chrono::steady_clock::time_point nextPoll;
+    std::atomic<bool> released{false};
+    std::mutex mutex;
+
+    TokenBucket directories;
+    TokenBucket entries;
+    TokenBucket bytes;
+
+    void applyRates();
+};
+
+/**
+ * @brief Moves the calling thread to the idle I/O scheduling class
+ *
+ * The thread's previous I/O priority is restored on destruction. Does
+ * nothing if enable is false or the platform has no I/O priorities.
+ */
+class IoPriorityGuard {
+public:
+    explicit IoPriorityGuard(bool enable);
+    ~IoPriorityGuard();
+
+    IoPriorityGuard(const IoPriorityGuard&) = delete;
+    IoPriorityGuard& operator=(const IoPriorityGuard&) = delete;
+
+private:
+    int previous = -1;
+};
@@ -0,0 +1,230 @@
+/**
+ * @file fs_top.cpp
+ * @brief Implementation of the largest / most recently modified files query
+ *
+ * The tree is walked by the parallel traversal engine, reading directories
+ * straight from disk rather than through the shared tree, which would keep
+ * every node. Every worker keeps its own bounded min-heap of the best K files
+ * it has seen, so memory stays O(K) per worker plus the directories still
+ * queued, no matter how large the tree is, and no locking is needed until the
+ * heaps are merged at the end. Sizes and times are read afresh on every run.
+ */
+
+#include "fs.h"
+#include "fs_tree.h"
+#include "fs_walk.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief A candidate for the result list
+ */
+struct TopItem {
+    fs::path path;
+    uint64_t size;
+    int64_t mtime;
+};
+
+/**
+ * @brief Reads size and modification time (ns since the Unix epoch) of a file
+ *
+ * On Linux this is a single statx call asking only for those two fields.
+ * Cached attributes are not accepted (no AT_STATX_DONT_SYNC), so network
+ * file systems report the current values.
+ *
+ * @return true if both values were read
+ */
+bool statFile(const fs::path& path, uint64_t& size, int64_t& mtime) {
+#if defined(__linux__) && defined(STATX_SIZE)
+    struct statx attributes;
+    if (statx(AT_FDCWD, path.c_str(), 0, STATX_SIZE | STATX_MTIME, &attributes) != 0) {
+        return false;
+    }
+    size = attributes.stx_size;
+    mtime = static_cast<int64_t>(attributes.stx_mtime.tv_sec) * 1000000000
+          + attributes.stx_mtime.tv_nsec;
+    return true;
+#else
+    std::error_code ec;
+    size = fs::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto written = fs::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    // file_time_type has no portable epoch in C++17; translate via "now"
+    auto systemTime = std::chrono::system_clock::now()
+                    + (written - fs::file_time_type::clock::now());
+    mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(systemTime.time_since_epoch()).count();
+    return true;
+#endif
+}
+
+/**
+ * @brief Formats a byte count with a binary unit, e.g. "1.5 GiB"
+ */
+std::string formatSize(uint64_t bytes) {
+    const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB"};
+    double value = static_cast<double>(bytes);
+    size_t unit = 0;
+    while (value >= 1024 && unit < 5) {
+        value /= 1024;
+        unit++;
+    }
+
+    std::ostringstream out;
+    if (unit == 0) {
+        out << bytes << " B";
+    } else {
+        out << std::fixed << std::setprecision(1) << value << " " << units[unit];
+    }
+    return out.str();
+}
+
+/**
+ * @brief Formats a modification time as local "YYYY-MM-DD HH:MM:SS"
+ */
+std::string formatTime(int64_t nanoseconds) {
+    std::time_t seconds = static_cast<std::time_t>(nanoseconds / 1000000000);
+    std::tm* local = std::localtime(&seconds);
+    if (!local) {
+        return "?";
+    }
+    std::ostringstream out;
+    out << std::put_time(local, "%Y-%m-%d %H:%M:%S");
+    return out.str();
+}
+
+/**
+ * @brief Results and counters owned by one worker of the walk
+ *
+ * Aligned to a cache line so workers updating their counters do not
+ * invalidate each other's lines.
+ */
+struct alignas(64) TopWorkerState {
+    std::vector<TopItem> heap;
+    uint64_t files = 0;
+    uint64_t unreadable = 0;
+};
+
+} // namespace
+
+void fsTop(const std::string& directory, bool byModificationTime, size_t count) {
+    try {
+        if (count == 0) {
+            std::cerr << "Error: The number of files must be at least 1\n";
+            return;
+        }
+
+        if (!fs::exists(directory)) {
+            std::cerr << "Error: The path '" << directory << "' does not exist.\n";
+            return;
+        }
+
+        // Results are printed as absolute paths
+        fs::path root = fs::absolute(fs::path(directory)).lexically_normal();
+
+        std::cout << "Finding the " << count
+                  << (byModificationTime ? " most recently modified" : " largest")
+                  << " files in: " << directory << "\n\n";
+
+        TreeWalker walker;
+        walker.setCaching(false);
+
+        // Orders the heap so that the weakest candidate is at the front
+        auto better = [byModificationTime](const TopItem& a, const TopItem& b) {
+            return byModificationTime ? a.mtime > b.mtime : a.size > b.size;
+        };
+        auto offer = [&](std::vector<TopItem>& heap, TopItem&& item) {
+            if (heap.size() < count) {
+                heap.push_back(std::move(item));
+                std::push_heap(heap.begin(), heap.end(), better);
+            } else if (better(item, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), better);
+                heap.back() = std::move(item);
+                std::push_heap(heap.begin(), heap.end(), better);
+            }
+        };
+
+        std::vector<TopWorkerState> workers(walker.threadCount());
+
+        if (fs::is_directory(directory)) {
+            walker.add(root);
+            walker.run([&](unsigned worker, const WalkDirectory& current,
+                           const std::vector<FsTree::Entry>& entries, const std::error_code& ec) {
+                TopWorkerState& state = workers[worker];
+                if (ec) {
+                    state.unreadable++;
+                }
+                for (const auto& entry : entries) {
+                    // Links would report their target a second time
+                    if (entry.isDirectory || entry.isSymlink) {
+                        continue;
+                    }
+
+                    TopItem item{current.path / entry.name, 0, 0};
+                    if (!statFile(item.path, item.size, item.mtime)) {
+                        continue;
+                    }
+                    state.files++;
+                    offer(state.heap, std::move(item));
+                }
+            });
+        } else {
+            // A single file is its own result
+            TopItem item{root, 0, 0};
+            if (statFile(item.path, item.size, item.mtime)) {
+                workers[0].files++;
+                offer(workers[0].heap, std::move(item));
+            }
+        }
+
+        // Merge the per-worker heaps
+        std::vector<TopItem> results;
+        uint64_t totalFiles = 0;
+        uint64_t totalUnreadable = 0;
+        for (auto& state : workers) {
+            results.insert(results.end(), std::make_move_iterator(state.heap.begin()),
+                           std::make_move_iterator(state.heap.end()));
+            totalFiles += state.files;
+            totalUnreadable += state.unreadable;
+        }
+        std::sort(results.begin(), results.end(), better);
+        if (results.size() > count) {
+            results.resize(count);
+        }
+
+        for (const auto& item : results) {
+            std::cout << std::setw(10) << formatSize(item.size) << "  "
+                      << formatTime(item.mtime) << "  "
+                      << item.path.string() << "\n";
+        }
+
+        if (totalUnreadable > 0) {
+            std::cerr << "Warning: " << totalUnreadable << " directories could not be read completely\n";
+        }
+        std::cout << "\nExamined " << totalFiles << " files\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error during top query: " << e.what() << "\n";
+    }
+}
@@ -0,0 +1,639 @@
+/**
+ * @file fs_tree.cpp
+ * @brief Implementation of the shared in-memory file system tree
+ *
+ * See fs_tree.h for the layout and the memory budget per entry. All public
+ * methods take the tree mutex; the private helpers assume it is held.
+ * Node ids stay valid until the next remove(), move(), invalidate() or
+ * clear(), which are the only operations that may compact the arrays.
+ */
+
+#include "fs_tree.h"
+#include "fs.h"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <utility>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Makes a path absolute and lexically normal, without a trailing separator
+ */
+fs::path normalize(const fs::path& path) {
+    std::error_code ec;
+    fs::path result = fs::absolute(path, ec);
+    if (ec) {
+        result = path;
+    }
+    result = result.lexically_normal();
+    if (!result.has_filename() && result.has_relative_path()) {
+        result = result.parent_path();
+    }
+    return result;
+}
+
+} // namespace
+
+bool FsTree::read(const fs::path& directory, std::vector<DiskEntry>& entries, std::error_code& ec) {
+    entries.clear();
+    fs::directory_iterator it(directory, fs::directory_options::skip_permission_denied, ec);
+    if (ec) {
+        return false;
+    }
+
+    for (; it != fs::directory_iterator(); it.increment(ec)) {
+        try {
+            // directory_entry caches the type reported by readdir, so this
+            // only costs a stat for symbolic links
+            std::error_code typeError;
+            bool isSymlink = it->is_symlink(typeError);
+            bool isDirectory = it->is_directory(typeError);
+            bool isOther = !isSymlink && !isDirectory && !it->is_regular_file(typeError);
+            entries.push_back({it->path().filename().string(), isDirectory, isSymlink, isOther});
+        } catch (...) {
+            continue;
+        }
+    }
+    return !ec;
+}
+
+FsTree::FsTree() {
+    reset();
+}
+
+void FsTree::reset() {
+    // Assign fresh vectors rather than clear() so the memory is released
+    parent = {};
+    nameId = {};
+    childBegin = {};
+    childCount = {};
+    device = {};
+    flags = {};
+    childIndex = {};
+    namePool = {};
+    nameOffsets.assign(1, 0);
+    nameSlots.assign(1024, 0);
+    deadNodes = 0;
+    deadSlots = 0;
+    changedDirectories = {};
+
+    // Node 0 is a virtual root whose children are the root components of
+    // absolute paths ("/" on Unix-like systems, drive names on Windows)
+    newNode(INVALID_NODE, intern(""), true);
+}
+
+FsTree::NodeId FsTree::newNode(NodeId parentNode, uint32_t name, bool isDirectory) {
+    NodeId id = static_cast<NodeId>(parent.size());
+    parent.push_back(parentNode);
+    nameId.push_back(name);
+    childBegin.push_back(0);
+    childCount.push_back(0);
+    device.push_back(0);
+    flags.push_back(isDirectory ? FLAG_DIRECTORY : 0);
+    return id;
+}
+
+std::string_view FsTree::nameOf(uint32_t name) const {
+    return std::string_view(namePool.data() + nameOffsets[name],
+                            nameOffsets[name + 1] - nameOffsets[name] - 1);
+}
+
+uint32_t FsTree::findName(std::string_view name) const {
+    size_t mask = nameSlots.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(name) & mask;
+
+    // Linear probing; a slot holds name id + 1, 0 marks an empty slot
+    while (nameSlots[slot] != 0) {
+        uint32_t candidate = nameSlots[slot] - 1;
+        if (nameOf(candidate) == name) {
+            return candidate;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return INVALID_NAME;
+}
+
+void FsTree::growNameSlots() {
+    nameSlots.assign(nameSlots.size() * 2, 0);
+    size_t mask = nameSlots.size() - 1;
+    uint32_t nameCount = static_cast<uint32_t>(nameOffsets.size() - 1);
+
+    for (uint32_t name = 0; name < nameCount; name++) {
+        size_t slot = std::hash<std::string_view>{}(nameOf(name)) & mask;
+        while (nameSlots[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        nameSlots[slot] = name + 1;
+    }
+}
+
+uint32_t FsTree::intern(std::string_view name) {
+    uint32_t existing = findName(name);
+    if (existing != INVALID_NAME) {
+        return existing;
+    }
+
+    uint32_t id = static_cast<uint32_t>(nameOffsets.size() - 1);
+    if ((static_cast<size_t>(id) + 1) * 2 > nameSlots.size()) {
+        growNameSlots();
+    }
+
+    namePool.insert(namePool.end(), name.begin(), name.end());
+    namePool.push_back('\0');
+    nameOffsets.push_back(static_cast<uint32_t>(namePool.size()));
+
+    size_t mask = nameSlots.size() - 1;
+    size_t slot = std::hash<std::string_view>{}(name) & mask;
+    while (nameSlots[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    nameSlots[slot] = id + 1;
+    return id;
+}
+
+FsTree::NodeId FsTree::childNamed(NodeId dir, uint32_t name) const {
+    uint32_t begin = childBegin[dir];
+    uint32_t end = begin + childCount[dir];
+    for (uint32_t i = begin; i < end; i++) {
+        if (nameId[childIndex[i]] == name) {
+            return childIndex[i];
+        }
+    }
+    return INVALID_NODE;
+}
+
+void FsTree::markChanged(NodeId dir) {
+    changedDirectories[dir] = ++generationCount;
+}
+
+void FsTree::attach(NodeId dir, NodeId child) {
+    markChanged(dir);
+    uint32_t begin = childBegin[dir];
+    uint32_t count = childCount[dir];
+
+    if (count == 0) {
+        childBegin[dir] = static_cast<uint32_t>(childIndex.size());
+    } else if (begin + count != childIndex.size()) {
+        // The range is not at the tail; move it there so it can grow
+        uint32_t newBegin = static_cast<uint32_t>(childIndex.size());
+        for (uint32_t i = 0; i < count; i++) {
+            NodeId moved = childIndex[begin + i];
+            childIndex.push_back(moved);
+        }
+        childBegin[dir] = newBegin;
+        deadSlots += count;
+    }
+
+    childIndex.push_back(child);
+    childCount[dir] = count + 1;
+    parent[child] = dir;
+}
+
+void FsTree::detach(NodeId child) {
+    NodeId dir = parent[child];
+    if (dir == INVALID_NODE) {
+        return;
+    }
+
+    markChanged(dir);
+    uint32_t begin = childBegin[dir];
+    uint32_t last = begin + childCount[dir] - 1;
+    for (uint32_t i = begin; i <= last; i++) {
+        if (childIndex[i] == child) {
+            childIndex[i] = childIndex[last];
+            break;
+        }
+    }
+
+    if (last + 1 == childIndex.size()) {
+        childIndex.pop_back();
+    } else {
+        deadSlots++;
+    }
+    childCount[dir]--;
+    parent[child] = INVALID_NODE;
+}
+
+size_t FsTree::subtreeSize(NodeId node) const {
+    size_t total = 0;
+    std::vector<NodeId> pending{node};
+    while (!pending.empty()) {
+        NodeId current = pending.back();
+        pending.pop_back();
+        total++;
+        uint32_t begin = childBegin[current];
+        pending.insert(pending.end(), childIndex.begin() + begin,
+                       childIndex.begin() + begin + childCount[current]);
+    }
+    return total;
+}
+
+void FsTree::graft(NodeId dir, const std::vector<DiskEntry>& entries, bool complete) {
+    if (flags[dir] & FLAG_LISTED) {
+        // Another thread listed this directory in the meantime
+        return;
+    }
+
+    // Children that are already known (placeholders, moved-in subtrees) keep
+    // their node ids so that cached descendants survive the relisting
+    uint32_t oldBegin = childBegin[dir];
+    uint32_t oldCount = childCount[dir];
+    std::unordered_map<uint32_t, NodeId> existing;
+    for (uint32_t i = oldBegin; i < oldBegin + oldCount; i++) {
+        existing.emplace(nameId[childIndex[i]], childIndex[i]);
+    }
+
+    uint32_t begin = static_cast<uint32_t>(childIndex.size());
+    for (const auto& [name, isDirectory, isSymlink, isOther] : entries) {
+        uint32_t nameIndex = intern(name);
+        NodeId child;
+
+        auto it = existing.find(nameIndex);
+        if (it != existing.end()) {
+            child = it->second;
+            existing.erase(it);
+            if (!isDirectory && (flags[child] & FLAG_DIRECTORY)) {
+                deadNodes += subtreeSize(child) - 1;
+                childCount[child] = 0;
+                flags[child] &= ~FLAG_LISTED;
+            }
+            flags[child] = isDirectory ? (flags[child] | FLAG_DIRECTORY)
+                                       : (flags[child] & ~(FLAG_DIRECTORY | FLAG_HAS_DEVICE));
+        } else {
+            child = newNode(dir, nameIndex, isDirectory);
+        }
+        flags[child] = isSymlink ? (flags[child] | FLAG_SYMLINK) : (flags[child] & ~FLAG_SYMLINK);
+        flags[child] = isOther ? (flags[child] | FLAG_OTHER) : (flags[child] & ~FLAG_OTHER);
+        childIndex.push_back(child);
+    }
+
+    for (const auto& [name, child] : existing) {
+        if (complete) {
+            // Gone from disk
+            deadNodes += subtreeSize(child);
+            parent[child] = INVALID_NODE;
+        } else {
+            childIndex.push_back(child);
+        }
+    }
+
+    markChanged(dir);
+    deadSlots += oldCount;
+    childBegin[dir] = begin;
+    childCount[dir] = static_cast<uint32_t>(childIndex.size() - begin);
+    if (complete) {
+        flags[dir] |= FLAG_LISTED;
+    }
+}
+
+FsTree::NodeId FsTree::walk(const fs::path& path, bool create) {
+    NodeId node = 0;
+    for (const auto& component : normalize(path)) {
+        std::string name = component.string();
+        if (name.empty()) {
+            continue;
+        }
+
+        uint32_t nameIndex = create ? intern(name) : findName(name);
+        if (nameIndex == INVALID_NAME) {
+            return INVALID_NODE;
+        }
+
+        NodeId child = childNamed(node, nameIndex);
+        if (child == INVALID_NODE) {
+            if (!create) {
+                return INVALID_NODE;
+            }
+            // A listed parent says this entry does not exist; the listing
+            // may be stale, so have it reread rather than trusting either
+            flags[node] &= ~FLAG_LISTED;
+            child = newNode(node, nameIndex, true);
+            attach(node, child);
+        }
+        node = child;
+    }
+    return node;
+}
+
+FsTree::NodeId FsTree::materialize(const fs::path& path, bool isDirectory, bool created) {
+    fs::path normalized = normalize(path);
+    fs::path::iterator last = normalized.end();
+    while (last != normalized.begin() && std::prev(last)->empty()) {
+        --last;
+    }
+
+    NodeId node = 0;
+    for (auto it = normalized.begin(); it != last; ++it) {
+        std::string name = it->string();
+        if (name.empty()) {
+            continue;
+        }
+
+        bool isLast = std::next(it) == last;
+        uint32_t nameIndex = intern(name);
+        NodeId child = childNamed(node, nameIndex);
+
+        if (child == INVALID_NODE) {
+            // Only a listed directory tells us the entry was really missing;
+            // anything else will be picked up by the next listing
+            if (!(flags[node] & FLAG_LISTED)) {
+                return INVALID_NODE;
+            }
+            bool childIsDirectory = isLast ? isDirectory : true;
+            child = newNode(node, nameIndex, childIsDirectory);
+            if (isLast && created && isDirectory) {
+                // Freshly created, so known to be empty. Missing parents may
+                // have been made by someone else in the meantime, so they are
+                // left to be listed from disk.
+                flags[child] |= FLAG_LISTED;
+            }
+            attach(node, child);
+        }
+        node = child;
+    }
+    return node;
+}
+
+void FsTree::maybeCompact() {
+    size_t liveNodes = parent.size() - deadNodes;
+    size_t liveSlots = childIndex.size() - deadSlots;
+    bool nodesWasted = parent.size() > 4096 && deadNodes > liveNodes;
+    bool slotsWasted = childIndex.size() > 4096 && deadSlots > liveSlots;
+    if (!nodesWasted && !slotsWasted) {
+        return;
+    }
+
+    // Copy everything reachable from the root into fresh arrays, breadth
+    // first, so every directory again gets a single contiguous range
+    std::vector<NodeId> oldParent = std::move(parent);
+    std::vector<uint32_t> oldNameId = std::move(nameId);
+    std::vector<uint32_t> oldChildBegin = std::move(childBegin);
+    std::vector<uint32_t> oldChildCount = std::move(childCount);
+    std::vector<uint64_t> oldDevice = std::move(device);
+    std::vector<uint8_t> oldFlags = std::move(flags);
+    std::vector<NodeId> oldChildIndex = std::move(childIndex);
+    std::vector<char> oldPool = std::move(namePool);
+    std::vector<uint32_t> oldOffsets = std::move(nameOffsets);
+
+    auto oldName = [&](NodeId node) {
+        uint32_t name = oldNameId[node];
+        return std::string_view(oldPool.data() + oldOffsets[name],
+                                oldOffsets[name + 1] - oldOffsets[name] - 1);
+    };
+
+    reset();
+    renumbered = ++generationCount;
+    parent.reserve(liveNodes);
+    childIndex.reserve(liveSlots);
+
+    std::vector<NodeId> order{0};
+    for (size_t next = 0; next < order.size(); next++) {
+        NodeId oldNode = order[next];
+        NodeId node = static_cast<NodeId>(next);
+        if (node != 0) {
+            nameId[node] = intern(oldName(oldNode));
+        }
+        device[node] = oldDevice[oldNode];
+        flags[node] = oldFlags[oldNode];
+
+        childBegin[node] = static_cast<uint32_t>(childIndex.size());
+        childCount[node] = oldChildCount[oldNode];
+        uint32_t begin = oldChildBegin[oldNode];
+        for (uint32_t i = begin; i < begin + oldChildCount[oldNode]; i++) {
+            NodeId child = newNode(node, 0, false);
+            childIndex.push_back(child);
+            order.push_back(oldChildIndex[i]);
+        }
+    }
+}
+
+FsTree::NodeId FsTree::locate(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return walk(path, true);
+}
+
+FsTree::NodeId FsTree::find(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return walk(path, false);
+}
+
+bool FsTree::list(NodeId dir, std::vector<Entry>& out, std::error_code& ec) {
+    out.clear();
+    ec.clear();
+
+    auto copyChildren = [&]() {
+        uint32_t begin = childBegin[dir];
+        out.reserve(childCount[dir]);
+        for (uint32_t i = begin; i < begin + childCount[dir]; i++) {
+            NodeId child = childIndex[i];
+            out.push_back({child, std::string(nameOf(nameId[child])),
+                           (flags[child] & FLAG_DIRECTORY) != 0,
+                           (flags[child] & FLAG_SYMLINK) != 0,
+                           (flags[child] & FLAG_OTHER) != 0});
+        }
+    };
+
+    fs::path path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (dir >= parent.size()) {
+            ec = std::make_error_code(std::errc::invalid_argument);
+            return false;
+        }
+        if ((flags[dir] & FLAG_LISTED) || !(flags[dir] & FLAG_DIRECTORY)) {
+            copyChildren();
+            return true;
+        }
+        path = pathOfUnlocked(dir);
+    }
+
+    // Read the directory without holding the lock so other threads can
+    // keep working on cached parts of the tree
+    std::vector<DiskEntry> entries;
+    bool complete = read(path, entries, ec);
+    if (ec && entries.empty()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    graft(dir, entries, complete);
+    copyChildren();
+    return complete;
+}
+
+bool FsTree::isListed(NodeId node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return node < parent.size() && (flags[node] & FLAG_LISTED);
+}
+
+bool FsTree::getDevice(NodeId node, uint64_t& deviceId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node >= parent.size() || !(flags[node] & FLAG_HAS_DEVICE)) {
+        return false;
+    }
+    deviceId = device[node];
+    return true;
+}
+
+void FsTree::setDevice(NodeId node, uint64_t deviceId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node >= parent.size() || !(flags[node] & FLAG_DIRECTORY)) {
+        return;
+    }
+    device[node] = deviceId;
+    flags[node] |= FLAG_HAS_DEVICE;
+}
+
+fs::path FsTree::pathOfUnlocked(NodeId node) const {
+    std::vector<NodeId> chain;
+    for (NodeId current = node; current != 0 && current != INVALID_NODE; current = parent[current]) {
+        chain.push_back(current);
+    }
+
+    fs::path result;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        result /= fs::path(std::string(nameOf(nameId[*it])));
+    }
+    return result;
+}
+
+fs::path FsTree::pathOf(NodeId node) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (node >= parent.size()) {
+        return fs::path();
+    }
+    return pathOfUnlocked(node);
+}
+
+void FsTree::insert(const fs::path& path, bool isDirectory) {
+    std::lock_guard<std::mutex> lock(mutex);
+    materialize(path, isDirectory, true);
+}
+
+void FsTree::remove(const fs::path& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    NodeId node = walk(path, false);
+    if (node == INVALID_NODE || node == 0) {
+        return;
+    }
+    detach(node);
+    deadNodes += subtreeSize(node);
+    maybeCompact();
+}
+
+void FsTree::move(const fs::path& oldPath, const fs::path& newPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    fs::path destination = normalize(newPath);
+
+    NodeId node = walk(oldPath, false);
+    if (node == INVALID_NODE || node == 0) {
+        // The source was never cached, so we do not know what arrived; let
+        // the destination directory be reread on its next listing
+        NodeId destinationParent = walk(destination.parent_path(), false);
+        if (destinationParent != INVALID_NODE) {
+            flags[destinationParent] &= ~FLAG_LISTED;
+            markChanged(destinationParent);
+        }
+        return;
+    }
+
+    detach(node);
+    NodeId destinationParent = materialize(destination.parent_path(), true, false);
+    if (destinationParent == INVALID_NODE) {
+        deadNodes += subtreeSize(node);
+    } else {
+        nameId[node] = intern(destination.filename().string());
+        attach(destinationParent, node);
+    }
+    maybeCompact();
+}
+
+void FsTree::invalidate(const fs::path& path, bool recursive) {
+    std::lock_guard<std::mutex> lock(mutex);
+    NodeId node = walk(path, false);
+    if (node == INVALID_NODE) {
+        return;
+    }
+
+    // Children stay attached, so a relisting reuses their nodes and only
+    // adds or drops what changed on disk
+    if (recursive) {
+        renumbered = ++generationCount;
+    } else {
+        markChanged(node);
+    }
+    std::vector<NodeId> pending{node};
+    while (!pending.empty()) {
+        NodeId current = pending.back();
+        pending.pop_back();
+        flags[current] &= ~FLAG_LISTED;
+        if (recursive) {
+            uint32_t begin = childBegin[current];
+            pending.insert(pending.end(), childIndex.begin() + begin,
+                           childIndex.begin() + begin + childCount[current]);
+        }
+    }
+    maybeCompact();
+}
+
+void FsTree::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    reset();
+    renumbered = ++generationCount;
+}
+
+uint64_t FsTree::generation(NodeId dir) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = changedDirectories.find(dir);
+    return it == changedDirectories.end() ? renumbered : std::max(renumbered, it->second);
+}
+
+FsTree::Stats FsTree::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result;
+    result.liveNodes = parent.size() - deadNodes;
+    result.deadNodes = deadNodes;
+    result.names = nameOffsets.size() - 1;
+    result.bytes = parent.capacity() * sizeof(NodeId)
+                 + nameId.capacity() * sizeof(uint32_t)
+                 + childBegin.capacity() * sizeof(uint32_t)
+                 + childCount.capacity() * sizeof(uint32_t)
+                 + device.capacity() * sizeof(uint64_t)
+                 + flags.capacity() * sizeof(uint8_t)
+                 + childIndex.capacity() * sizeof(NodeId)
+                 + namePool.capacity()
+                 + nameOffsets.capacity() * sizeof(uint32_t)
+                 + nameSlots.capacity() * sizeof(uint32_t);
+    return result;
+}
+
+void fsCache(const std::string& option) {
+    FsTree& tree = fileTree();
+
+    if (option == "clear") {
+        tree.clear();
+        std::cout << "Directory cache cleared\n";
+        return;
+    }
+    if (!option.empty()) {
+        std::cerr << "Error: Unknown cache option '" << option << "' (expected: clear)\n";
+        return;
+    }
+
+    FsTree::Stats stats = tree.stats();
+    std::cout << "Cached entries: " << stats.liveNodes << "\n"
+              << "Distinct names: " << stats.names << "\n"
+              << "Memory used:    " << stats.bytes << " bytes";
+    if (stats.liveNodes > 0) {
+        std::cout << " (" << stats.bytes / stats.liveNodes << " per entry)";
+    }
+    std::cout << "\n";
+    if (stats.deadNodes > 0) {
+        std::cout << "Awaiting compaction: " << stats.deadNodes << " entries\n";
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @file fs_tree.h
+ * @brief Shared in-memory model of the explored file system
+ *
+ * Commands read directories through this cache instead of going to the
+ * file system directly, so a directory that has been listed once is served
+ * from memory afterwards. File operations in fs_manage.cpp keep the model
+ * in sync (a rename relinks the cached subtree instead of rescanning it).
+ *
+ * Layout: nodes are stored as parallel arrays indexed by NodeId, names are
+ * interned once in a single character pool, and the children of a directory
+ * occupy one contiguous range of the child index array.
+ *
+ * Memory per entry:
+ *   parent, name, childBegin, childCount   4 x 4 bytes
+ *   device (directories only)              8 bytes
+ *   flags                                  1 byte
+ *   slot in the child index                4 bytes
+ *   = 29 bytes, plus the name. Each distinct name is stored once and costs
+ *   its length + 1 terminator + 4 bytes of offset + at most 8 bytes of hash
+ *   table.
+ * Nodes and child slots orphaned by updates are reclaimed by compaction as
+ * soon as they outnumber the live ones, so usage stays below twice that.
+ */
+class FsTree {
+public:
+    using NodeId = uint32_t;
+    static constexpr NodeId INVALID_NODE = UINT32_MAX;
+
+    /**
+     * @brief One child of a listed directory, as returned by list()
+     *
+     * isDirectory follows symbolic links; traversals should not descend into
+     * entries that are also symlinks, which could otherwise loop forever.
+     * isOther marks FIFOs, sockets and devices (not followed through symlinks).
+     */
+    struct Entry {
+        NodeId id;
+        std::string name;
+        bool isDirectory;
+        bool isSymlink;
+        bool isOther;
+    };
+
+    /**
+     * @brief A directory entry as read from disk, before it is grafted
+     */
+    struct DiskEntry {
+        std::string name;
+        bool isDirectory;
+        bool isSymlink;
+        bool isOther;
+    };
+
+    /**
+     * @brief Size and accounting information for the `cache` command
+     */
+    struct Stats {
+        size_t liveNodes;
+        size_t deadNodes;
+        size_t names;
+        size_t bytes;
+    };
+
+    FsTree();
+
+    /**
+     * @brief Finds the node for a path, creating unlisted placeholders as needed
+     *
+     * @param path Absolute or relative (to the process) path
+     * @return NodeId The node representing the path
+     */
+    NodeId locate(const std::filesystem::path& path);
+
+    /**
+     * @brief Finds the node for a path without modifying the tree
+     *
+     * @return NodeId The node, or INVALID_NODE if the path is not cached
+     */
+    NodeId find(const std::filesystem::path& path);
+
+    /**
+     * @brief Returns the children of a directory
+     *
+     * Served from memory if the directory was listed before, otherwise the
+     * directory is read from disk (outside the lock) and cached.
+     *
+     * @param dir The directory node
+     * @param out Receives the children
+     * @param ec Set if the directory could not be read
+     * @return true if the listing is complete, false on error
+     */
+    bool list(NodeId dir, std::vector<Entry>& out, std::error_code& ec);
+
+    /**
+     * @brief Reads a directory straight from disk, bypassing the cache
+     *
+     * For walks that must not keep the whole tree in memory.
+     *
+     * @return true if the whole directory was read, false if reading stopped early
+     */
+    static bool read(const std::filesystem::path& directory, std::vector<DiskEntry>& out,
+                     std::error_code& ec);
+
+    /**
+     * @brief Checks whether a node is a directory whose children are cached
+     */
+    bool isListed(NodeId node);
+
+    /**
+     * @brief Reads the cached device (st_dev) of a directory
+     *
+     * @return true if the device is known
+     */
+    bool getDevice(NodeId node, uint64_t& device);
+
+    /**
+     * @brief Records the device (st_dev) a directory lives on
+     */
+    void setDevice(NodeId node, uint64_t device);
+
+    /**
+     * @brief Rebuilds the path of a node
+     */
+    std::filesystem::path pathOf(NodeId node);
+
+    /**
+     * @brief Records a newly created file or directory (and missing parents)
+     */
+    void insert(const std::filesystem::path& path, bool isDirectory);
+
+    /**
+     * @brief Forgets a deleted file or directory and its cached subtree
+     */
+    void remove(const std::filesystem::path& path);
+
+    /**
+     * @brief Relinks a renamed or moved subtree without rescanning it
+     */
+    void move(const std::filesystem::path& oldPath, const std::filesystem::path& newPath);
+
+    /**
+     * @brief Marks a directory as stale so its next listing rereads the disk
+     *
+     * @param recursive true to mark every cached directory below it as well,
+     *                  for commands that must see the current state of disk
+     */
+    void invalidate(const std::filesystem::path& path, bool recursive = false);
+
+    /**
+     * @brief Drops everything that is cached
+     */
+    void clear();
+
+    /**
+     * @brief Counter that changes whenever the cached listing of a directory does
+     *
+     * Data derived from one listing (e.g. a completion trie) stays valid for
+     * as long as the generation of that directory is the same; changes
+     * elsewhere in the tree leave it alone. Node ids are only renumbered by
+     * compaction and clear(), which change the generation of every directory.
+     */
+    uint64_t generation(NodeId dir);
+
+    Stats stats();
+
+private:
+    enum : uint8_t {
+        FLAG_DIRECTORY = 1,
+        FLAG_LISTED = 2,
+        FLAG_SYMLINK = 4,
+        FLAG_HAS_DEVICE = 8,
+        FLAG_OTHER = 16       // Neither directory, regular file nor symlink
+    };
+
+
+    static constexpr uint32_t INVALID_NAME = UINT32_MAX;
+
+    // Node arrays, all indexed by NodeId
+    std::vector<NodeId> parent;
+    std::vector<uint32_t> nameId;
+    std::vector<uint32_t> childBegin;
+    std::vector<uint32_t> childCount;
+    std::vector<uint64_t> device;
+    std::vector<uint8_t> flags;
+
+    // Children ranges point into this array
+    std::vector<NodeId> childIndex;
+
+    // Interned names: NUL-terminated strings in namePool, nameOffsets has one
+    // extra trailing element so the length of name i is derived from i + 1
+    std::vector<char> namePool;
+    std::vector<uint32_t> nameOffsets;
+    std::vector<uint32_t> nameSlots;
+
+    size_t deadNodes = 0;
+    size_t deadSlots = 0;
+    uint64_t generationCount = 0;
+    uint64_t renumbered = 0;   // Generation at which every directory last changed
+    std::unordered_map<NodeId, uint64_t> changedDirectories;
+
+    std::mutex mutex;
+
+    void reset();
+    NodeId newNode(NodeId parentNode, uint32_t name, bool isDirectory);
+    uint32_t intern(std::string_view name);
+    uint32_t findName(std::string_view name) const;
+    std::string_view nameOf(uint32_t name) const;
+    void growNameSlots();
+    NodeId childNamed(NodeId dir, uint32_t name) const;
+    void markChanged(NodeId dir);
+    void attach(NodeId dir, NodeId child);
+    void detach(NodeId child);
+    size_t subtreeSize(NodeId node) const;
+    void graft(NodeId dir, const std::vector<DiskEntry>& entries, bool complete);
+    NodeId walk(const std::filesystem::path& path, bool create);
+    NodeId materialize(const std::filesystem::path& path, bool isDirectory, bool created);
+    std::filesystem::path pathOfUnlocked(NodeId node) const;
+    void maybeCompact();
+};
+
+/**
+ * @brief Returns the tree shared by all commands
+ */
+FsTree& fileTree();
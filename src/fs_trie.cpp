@@ -0,0 +1,111 @@
+/**
+ * @file fs_trie.cpp
+ * @brief Implementation of the directory prefix trie
+ */
+
+#include "fs_trie.h"
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief Length of the common prefix of two strings
+ */
+size_t commonPrefix(const std::string& a, const std::string& b) {
+    size_t limit = std::min(a.size(), b.size());
+    size_t length = 0;
+    while (length < limit && a[length] == b[length]) {
+        length++;
+    }
+    return length;
+}
+
+} // namespace
+
+PrefixTrie::PrefixTrie(std::vector<Item> entries) : items(std::move(entries)) {
+    std::sort(items.begin(), items.end(),
+              [](const Item& a, const Item& b) { return a.name < b.name; });
+    if (items.empty()) {
+        return;
+    }
+
+    // Built breadth first: when a node is processed its children are
+    // appended together, which keeps every child list contiguous
+    nodes.reserve(items.size() * 2);
+    nodes.push_back({0, static_cast<uint32_t>(items.size()), 0, 0, 0});
+
+    for (size_t index = 0; index < nodes.size(); index++) {
+        Node node = nodes[index];
+
+        // In a sorted range the first and last names have the shortest
+        // common prefix, which is shared by all names in between
+        node.depth = static_cast<uint32_t>(commonPrefix(items[node.begin].name, items[node.end - 1].name));
+
+        // A name that ends exactly here sorts first and has no child
+        uint32_t split = node.begin;
+        if (items[split].name.size() == node.depth) {
+            split++;
+        }
+
+        node.firstChild = static_cast<uint32_t>(nodes.size());
+        node.childCount = 0;
+        while (split < node.end) {
+            char next = items[split].name[node.depth];
+            uint32_t groupEnd = split + 1;
+            while (groupEnd < node.end && items[groupEnd].name[node.depth] == next) {
+                groupEnd++;
+            }
+            nodes.push_back({split, groupEnd, node.depth + 1, 0, 0});
+            node.childCount++;
+            split = groupEnd;
+        }
+        nodes[index] = node;
+    }
+}
+
+size_t PrefixTrie::size() const {
+    return items.size();
+}
+
+const PrefixTrie::Item& PrefixTrie::item(size_t index) const {
+    return items[index];
+}
+
+bool PrefixTrie::findPrefix(std::string_view prefix, size_t& begin, size_t& end, size_t& commonLength) const {
+    if (nodes.empty()) {
+        return false;
+    }
+
+    size_t checked = 0;
+    const Node* node = &nodes[0];
+    while (true) {
+        // Compare the characters this node adds to the path
+        const std::string& name = items[node->begin].name;
+        size_t limit = std::min<size_t>(node->depth, prefix.size());
+        for (; checked < limit; checked++) {
+            if (name[checked] != prefix[checked]) {
+                return false;
+            }
+        }
+
+        if (prefix.size() <= node->depth) {
+            begin = node->begin;
+            end = node->end;
+            commonLength = node->depth;
+            return true;
+        }
+
+        // Pick the child for the next character by binary search
+        char next = prefix[node->depth];
+        auto first = nodes.begin() + node->firstChild;
+        auto last = first + node->childCount;
+        auto child = std::lower_bound(first, last, next, [&](const Node& candidate, char c) {
+            return static_cast<unsigned char>(items[candidate.begin].name[node->depth])
+                 < static_cast<unsigned char>(c);
+        });
+        if (child == last || items[child->begin].name[node->depth] != next) {
+            return false;
+        }
+        node = &*child;
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @file fs_trie.h
+ * @brief Prefix trie over the names of one directory, used for Tab completion
+ *
+ * The trie is built once from a directory listing and then answers prefix
+ * queries in time proportional to the prefix length, independent of the
+ * number of entries. It is a compressed (radix) trie over the sorted names:
+ * every node covers a contiguous range of names sharing its prefix, so a
+ * query returns all completions as one range plus their longest common
+ * prefix, without visiting them.
+ */
+class PrefixTrie {
+public:
+    /**
+     * @brief A name and whether it is a directory
+     */
+    struct Item {
+        std::string name;
+        bool isDirectory;
+    };
+
+    PrefixTrie() = default;
+
+    /**
+     * @brief Builds the trie; the items are sorted by name
+     */
+    explicit PrefixTrie(std::vector<Item> items);
+
+    size_t size() const;
+    const Item& item(size_t index) const;
+
+    /**
+     * @brief Finds all names that start with a prefix
+     *
+     * @param prefix The prefix to look up
+     * @param begin Receives the index of the first match
+     * @param end Receives the index past the last match
+     * @param commonLength Receives the length of the longest common prefix of the matches
+     * @return true if at least one name matches
+     */
+    bool findPrefix(std::string_view prefix, size_t& begin, size_t& end, size_t& commonLength) const;
+
+private:
+    // Node covering items [begin, end), whose names share their first depth
+    // characters; its children are contiguous and ordered by the next character
+    struct Node {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t depth;
+        uint32_t firstChild;
+        uint32_t childCount;
+    };
+
+    std::vector<Item> items;
+    std::vector<Node> nodes;
+};
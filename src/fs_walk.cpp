@@ -0,0 +1,420 @@
+/**
+ * @file fs_walk.cpp
+ * @brief Implementation of the parallel directory traversal engine
+ *
+ * Every device has its own stack of pending directories. A worker takes a
+ * directory from the least busy device that is below its limit, lists it
+ * through the shared tree, hands the entries to the visitor and pushes the
+ * subdirectories onto the stacks of their devices. The walk is over when
+ * all stacks are empty and no worker is still listing (and could push more).
+ */
+
+#include "fs_walk.h"
+#include "fs.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#elif !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * @brief Listings this many times slower than the fastest device mark a slow device
+ */
+const double SLOW_DEVICE_FACTOR = 8;
+
+/**
+ * @brief Listings needed before a device's latency is trusted
+ */
+const unsigned MIN_LATENCY_SAMPLES = 8;
+
+/**
+ * @brief Time per entry (ms) below which no device counts as slow
+ */
+const double MIN_SLOW_LATENCY = 0.05;
+
+/**
+ * @brief Rough number of entries one getdents call returns (32 KiB buffer)
+ */
+const size_t ENTRIES_PER_READ = 512;
+
+/**
+ * @brief Reads the device (st_dev) of a directory without following symlinks
+ *
+ * @return true if the device was read
+ */
+bool readDevice(const fs::path& path, uint64_t& device) {
+#if defined(__linux__) && defined(STATX_TYPE)
+    // No fields are requested: the device is always filled in, and cached
+    // attributes are good enough for it
+    struct statx attributes;
+    if (statx(AT_FDCWD, path.c_str(), AT_SYMLINK_NOFOLLOW | AT_STATX_DONT_SYNC, 0, &attributes) != 0) {
+        return false;
+    }
+    device = (static_cast<uint64_t>(attributes.stx_dev_major) << 32) | attributes.stx_dev_minor;
+    return true;
+#elif !defined(_WIN32)
+    struct stat attributes;
+    if (::lstat(path.c_str(), &attributes) != 0) {
+        return false;
+    }
+    device = static_cast<uint64_t>(attributes.st_dev);
+    return true;
+#else
+    // std::filesystem does not expose the volume; treat everything as one device
+    (void)path;
+    device = 0;
+    return true;
+#endif
+}
+
+/**
+ * @brief Device of a directory, cached in the tree after the first lookup
+ *
+ * Nodes outside the tree (walks without caching) are looked up every time.
+ *
+ * @param fallback Used if the device cannot be read (usually the parent's)
+ */
+uint64_t deviceOf(FsTree& tree, FsTree::NodeId node, const fs::path& path, uint64_t fallback) {
+    uint64_t device;
+    bool inTree = node != FsTree::INVALID_NODE;
+    if (inTree && tree.getDevice(node, device)) {
+        return device;
+    }
+    if (!readDevice(path, device)) {
+        return fallback;
+    }
+    if (inTree) {
+        tree.setDevice(node, device);
+    }
+    return device;
+}
+
+} // namespace
+
+TreeWalker::TreeWalker(unsigned threads) : threads(threads) {
+    if (this->threads == 0) {
+        // Listing is mostly waiting on the file system, so use a few more
+        // workers than cores; this matters most on network file systems
+        this->threads = std::clamp(std::thread::hardware_concurrency() * 2, 4u, 32u);
+    }
+
+    // With several devices busy, a quarter of the pool stays free for the
+    // others, so one stalled device cannot take every worker
+    deviceLimit = std::max(1u, this->threads - this->threads / 4);
+    inFlight.assign(this->threads, nullptr);
+    uncommitted.assign(this->threads, 0);
+}
+
+unsigned TreeWalker::threadCount() const {
+    return threads;
+}
+
+void TreeWalker::setSameDevice(bool sameDevice) {
+    this->sameDevice = sameDevice;
+}
+
+void TreeWalker::setCaching(bool caching) {
+    this->caching = caching;
+}
+
+void TreeWalker::setThrottle(IoThrottle* throttle) {
+    this->throttle = throttle;
+}
+
+void TreeWalker::add(const fs::path& path) {
+    FsTree& tree = fileTree();
+    FsTree::NodeId node = caching ? tree.locate(path) : FsTree::INVALID_NODE;
+    uint64_t device = deviceOf(tree, node, path, 0);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    push({node, path, device});
+}
+
+size_t TreeWalker::queueFor(uint64_t device) {
+    for (size_t index = 0; index < devices.size(); index++) {
+        if (devices[index].device == device) {
+            return index;
+        }
+    }
+    DeviceQueue queue;
+    queue.device = device;
+    queue.limit = deviceLimit;
+    devices.push_back(std::move(queue));
+    return devices.size() - 1;
+}
+
+void TreeWalker::push(WalkDirectory directory) {
+    size_t queue = queueFor(directory.device);
+    devices[queue].pending.push_back(std::move(directory));
+    pendingCount++;
+}
+
+int TreeWalker::pickQueue() const {
+    // Limits only matter when devices compete for workers
+    size_t busyDevices = 0;
+    for (const auto& queue : devices) {
+        if (!queue.pending.empty() || queue.active > 0) {
+            busyDevices++;
+        }
+    }
+
+    int best = -1;
+    for (size_t index = 0; index < devices.size(); index++) {
+        const DeviceQueue& queue = devices[index];
+        unsigned limit = busyDevices > 1 ? queue.limit : threads;
+        if (queue.pending.empty() || queue.active >= limit) {
+            continue;
+        }
+        if (best < 0 || queue.active < devices[best].active) {
+            best = static_cast<int>(index);
+        }
+    }
+    return best;
+}
+
+void TreeWalker::recordLatency(size_t queue, double milliseconds) {
+    DeviceQueue& current = devices[queue];
+    current.latency = current.samples == 0 ? milliseconds : current.latency * 0.8 + milliseconds * 0.2;
+    current.samples++;
+
+    double fastest = -1;
+    for (const auto& device : devices) {
+        if (device.samples >= MIN_LATENCY_SAMPLES && (fastest < 0 || device.latency < fastest)) {
+            fastest = device.latency;
+        }
+    }
+    if (fastest < 0) {
+        return;
+    }
+
+    // Slow devices (USB disks, distant mounts) gain little from many
+    // concurrent requests, so they get fewer workers
+    for (auto& device : devices) {
+        bool slow = device.samples >= MIN_LATENCY_SAMPLES
+                 && device.latency > MIN_SLOW_LATENCY
+                 && device.latency > fastest * SLOW_DEVICE_FACTOR;
+        device.limit = slow ? std::max(1u, deviceLimit / 4) : deviceLimit;
+    }
+}
+
+std::vector<fs::path> TreeWalker::pendingPaths() const {
+    std::vector<fs::path> paths;
+    paths.reserve(pendingCount);
+    for (const auto& queue : devices) {
+        for (const auto& directory : queue.pending) {
+            paths.push_back(directory.path);
+        }
+    }
+    for (const WalkDirectory* directory : inFlight) {
+        if (directory) {
+            paths.push_back(directory->path);
+        }
+    }
+    return paths;
+}
+
+void TreeWalker::run(const Visitor& visit, const Monitor& monitor) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (unsigned worker = 0; worker < threads; worker++) {
+        workers.emplace_back(&TreeWalker::work, this, worker, std::cref(visit));
+    }
+
+    // The calling thread only supervises, so the monitor can stop
+    // the workers without being one of them
+    if (monitor) {
+        auto finished = [this] { return stopping || (pendingCount == 0 && active == 0); };
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!idle.wait_for(lock, std::chrono::milliseconds(100), finished)) {
+            lock.unlock();
+            bool keepGoing = monitor();
+            lock.lock();
+            if (!keepGoing) {
+                stopping = true;
+                wakeUp.notify_all();
+                // Workers finish their directories without waiting for tokens
+                if (throttle) {
+                    throttle->release();
+                }
+            }
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void TreeWalker::countResults(unsigned worker, uint64_t count) {
+    // Only the worker itself touches its slot until the visit is committed
+    uncommitted[worker] += count;
+}
+
+void TreeWalker::setResults(uint64_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    committed = count;
+}
+
+uint64_t TreeWalker::results() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return committed;
+}
+
+void TreeWalker::snapshot(const SnapshotHandler& handle) {
+    std::vector<fs::path> paths;
+    uint64_t count;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paths = pendingPaths();
+        count = committed;
+    }
+    handle(paths, count);
+}
+
+std::vector<fs::path> TreeWalker::remaining() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pendingPaths();
+}
+
+void TreeWalker::work(unsigned worker, const Visitor& visit) {
+    FsTree& tree = fileTree();
+    std::vector<FsTree::Entry> entries;
+    std::vector<FsTree::DiskEntry> diskEntries;
+    std::vector<WalkDirectory> subdirectories;
+    IoPriorityGuard priority(throttle && throttle->idlePriority());
+
+    while (true) {
+        WalkDirectory current;
+        size_t queue;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            int picked = -1;
+            wakeUp.wait(lock, [&] {
+                picked = -1;
+                if (stopping || (pendingCount == 0 && active == 0)) {
+                    return true;
+                }
+                picked = pickQueue();
+                return picked >= 0;
+            });
+            if (picked < 0) {
+                // Stopped, or nothing queued and nobody left who could queue more
+                wakeUp.notify_all();
+                idle.notify_all();
+                return;
+            }
+            queue = static_cast<size_t>(picked);
+            current = std::move(devices[queue].pending.back());
+            devices[queue].pending.pop_back();
+            devices[queue].active++;
+            pendingCount--;
+            active++;
+            inFlight[worker] = &current;
+        }
+
+        subdirectories.clear();
+        double latency = -1;
+        size_t entriesRead = 0;
+        try {
+            if (!shouldSkipPath(current.path.string())) {
+                // Only listings read from disk say anything about the device
+                bool cached = caching && tree.isListed(current.node);
+                auto started = std::chrono::steady_clock::now();
+                std::error_code errorCode;
+                if (caching) {
+                    tree.list(current.node, entries, errorCode);
+                } else {
+                    FsTree::read(current.path, diskEntries, errorCode);
+                    entries.clear();
+                    for (auto& entry : diskEntries) {
+                        entries.push_back({FsTree::INVALID_NODE, std::move(entry.name),
+                                           entry.isDirectory, entry.isSymlink, entry.isOther});
+                    }
+                }
+                if (!cached) {
+                    double elapsed = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - started).count();
+                    entriesRead = entries.size();
+                    if (throttle) {
+                        // The backoff compares syscall latencies, so a listing
+                        // counts as one call per getdents batch
+                        throttle->recordLatency(elapsed / static_cast<double>(entriesRead / ENTRIES_PER_READ + 1));
+                    }
+                    // Large directories take longer on any device, so devices
+                    // are compared by the time per entry (opening counts as one)
+                    latency = elapsed / static_cast<double>(entriesRead + 1);
+                }
+
+                // Drop system entries once here instead of in every visitor
+                entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                             [&](const FsTree::Entry& entry) {
+                                                 return shouldSkipPath((current.path / entry.name).string());
+                                             }),
+                              entries.end());
+
+                visit(worker, current, entries, errorCode);
+
+                for (const auto& entry : entries) {
+                    // Symbolic links are not followed, so cycles cannot occur
+                    if (!entry.isDirectory || entry.isSymlink) {
+                        continue;
+                    }
+                    fs::path path = current.path / entry.name;
+                    uint64_t device = deviceOf(tree, entry.id, path, current.device);
+                    if (sameDevice && device != current.device) {
+                        continue;
+                    }
+                    subdirectories.push_back({entry.id, std::move(path), device});
+                }
+            }
+        } catch (...) {
+            // Skip directories that cause errors
+        }
+
+        bool wakeOthers;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (latency >= 0) {
+                recordLatency(queue, latency);
+            }
+            // A worker may be waiting for this device to drop below its limit
+            wakeOthers = devices[queue].active >= devices[queue].limit;
+            devices[queue].active--;
+            active--;
+            // The directory and its results leave the frontier together
+            inFlight[worker] = nullptr;
+            committed += uncommitted[worker];
+            uncommitted[worker] = 0;
+            for (auto& subdirectory : subdirectories) {
+                push(std::move(subdirectory));
+            }
+            wakeOthers = wakeOthers || !subdirectories.empty() || active == 0;
+        }
+        if (wakeOthers) {
+            wakeUp.notify_all();
+            idle.notify_all();
+        }
+
+        // Disk reads are paid for once the directory is committed, so a
+        // worker sleeping off token debt holds nothing back and an interrupt
+        // is noticed within one monitor period
+        if (throttle && latency >= 0) {
+            throttle->acquireDirectory();
+            throttle->acquireEntries(entriesRead);
+        }
+    }
+}
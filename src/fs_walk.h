@@ -0,0 +1,179 @@
+#pragma once
+
+#include "fs_throttle.h"
+#include "fs_tree.h"
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+/**
+ * @file fs_walk.h
+ * @brief Parallel directory traversal engine
+ *
+ * Walks a directory tree with a pool of worker threads. Directories are
+ * listed through the shared FsTree, so cached parts of the tree cost no
+ * syscalls, unless caching is turned off for the walk. The visitor is called once per directory from whichever worker
+ * listed it, together with that worker's index, so callers can keep
+ * per-worker state (e.g. result heaps) without locking and merge it at the end.
+ *
+ * Pending directories are queued per device (st_dev). Workers take the
+ * device with the fewest active workers, and once the walk spans several
+ * devices none of them may occupy more than its share of the pool, so a
+ * slow disk or network mount cannot hold up the others. Devices whose
+ * listings take much longer per entry than on the fastest one get a lower
+ * limit still.
+ *
+ * With a throttle set (--nice), every listing read from disk is paid for
+ * with tokens before the worker takes its next directory, and workers run in
+ * the idle I/O scheduling class if requested.
+ */
+
+/**
+ * @brief A directory waiting to be listed
+ */
+struct WalkDirectory {
+    FsTree::NodeId node;   // INVALID_NODE when the walk does not cache
+    std::filesystem::path path;
+    uint64_t device = 0;   // st_dev of the directory, 0 where unknown
+};
+
+class TreeWalker {
+public:
+    /**
+     * @brief Called for every listed directory
+     *
+     * @param worker Index of the calling worker, below threadCount()
+     * @param directory The directory that was listed
+     * @param entries Its children (system paths already removed)
+     * @param ec Set if the directory could not be read completely
+     */
+    using Visitor = std::function<void(unsigned worker, const WalkDirectory& directory,
+                                       const std::vector<FsTree::Entry>& entries,
+                                       const std::error_code& ec)>;
+
+    /**
+     * @brief Called by run() on the calling thread about every 100 ms
+     *
+     * May call snapshot(). Returning false stops the walk; the directories
+     * that were not listed yet are then available from remaining().
+     */
+    using Monitor = std::function<bool()>;
+
+    /**
+     * @param threads Number of workers, 0 to pick one based on the hardware
+     */
+    explicit TreeWalker(unsigned threads = 0);
+
+    unsigned threadCount() const;
+
+    /**
+     * @brief Keeps the walk on the devices of the starting directories
+     *
+     * Subdirectories on another file system (mount points) are still passed
+     * to the visitor as entries, but not descended into.
+     */
+    void setSameDevice(bool sameDevice);
+
+    /**
+     * @brief Reads every directory from disk without adding it to the shared tree
+     *
+     * Memory then depends on the directories still queued, not on the size
+     * of the tree. Entries passed to the visitor carry INVALID_NODE.
+     */
+    void setCaching(bool caching);
+
+    /**
+     * @brief Rate limits disk listings; the throttle must outlive run()
+     */
+    void setThrottle(IoThrottle* throttle);
+
+    /**
+     * @brief Queues a directory to start the walk from
+     */
+    void add(const std::filesystem::path& path);
+
+    /**
+     * @brief Walks all queued directories and everything below them
+     *
+     * Returns once every reachable directory has been visited, or once the
+     * monitor asked to stop and the directories being listed are done.
+     */
+    void run(const Visitor& visit, const Monitor& monitor = nullptr);
+
+    /**
+     * @brief Counts results the visitor found in the directory it is visiting
+     *
+     * Only meant for the visitor. The count is committed together with the
+     * directory once its visit is complete, so it never includes a
+     * directory that a snapshot still reports as pending.
+     */
+    void countResults(unsigned worker, uint64_t count);
+
+    /**
+     * @brief Starts the result count at count, e.g. to resume a walk
+     */
+    void setResults(uint64_t count);
+
+    /**
+     * @brief Results committed by completed visits, plus the starting count
+     */
+    uint64_t results();
+
+    /**
+     * @brief Called by snapshot() with the unfinished directories and the results so far
+     */
+    using SnapshotHandler = std::function<void(const std::vector<std::filesystem::path>& pending,
+                                               uint64_t results)>;
+
+    /**
+     * @brief Hands a consistent checkpoint of the walk to the handler
+     *
+     * Meant to be called from the monitor. The workers keep going: directories
+     * being listed are reported as pending and their results are not counted
+     * yet, so a walk resumed from the frontier repeats them rather than
+     * losing anything. The handler runs after the walker's lock is released.
+     */
+    void snapshot(const SnapshotHandler& handle);
+
+    /**
+     * @brief Directories left unlisted by a stopped walk
+     */
+    std::vector<std::filesystem::path> remaining();
+
+private:
+    struct DeviceQueue {
+        uint64_t device;
+        std::vector<WalkDirectory> pending;
+        unsigned active = 0;
+        unsigned limit;
+        double latency = 0;   // Average time per entry of listings read from disk, in ms
+        unsigned samples = 0;
+    };
+
+    unsigned threads;
+    unsigned deviceLimit;
+    bool sameDevice = false;
+    bool caching = true;
+    IoThrottle* throttle = nullptr;
+    std::vector<DeviceQueue> devices;
+    size_t pendingCount = 0;
+    unsigned active = 0;
+    std::vector<const WalkDirectory*> inFlight;   // Per worker, nullptr while idle
+    std::vector<uint64_t> uncommitted;            // Per worker, results of inFlight
+    uint64_t committed = 0;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable idle;
+
+    size_t queueFor(uint64_t device);
+    void push(WalkDirectory directory);
+    int pickQueue() const;
+    void recordLatency(size_t queue, double milliseconds);
+    std::vector<std::filesystem::path> pendingPaths() const;
+    void work(unsigned worker, const Visitor& visit);
+};
@@ -1,18 +1,23 @@
 #include "fs.h"
+#include "fs_lineedit.h"
 #include <iostream>
 #include <string>
-#include <limits>
+#include <sstream>
+#include <stdexcept>
 #include <filesystem>
+#include <vector>
 
 namespace fs = std::filesystem;
 
 /**
- * @brief Displays the command prompt with current directory
+ * @brief Builds the command prompt with current directory
  * 
  * Shows the current working directory in the prompt, abbreviated if too long.
  * The last directory name is always shown in full, while the path may be truncated.
+ * 
+ * @return std::string The prompt text
  */
-void displayPrompt() {
+std::string buildPrompt() {
     std::string currentDir = getCurrentDirectory();
     fs::path dirPath(currentDir);
     
@@ -22,10 +27,85 @@ void displayPrompt() {
     // If the path is too long, abbreviate it
     if (currentDir.length() > 40) {
         std::string abbreviated = "..." + currentDir.substr(currentDir.length() - 37);
-        std::cout << abbreviated << "> ";
-    } else {
-        std::cout << currentDir << "> ";
+        return abbreviated + "> ";
+    }
+    return currentDir + "> ";
+}
+
+/**
+ * @brief Splits a line into whitespace separated arguments
+ * 
+ * Double quotes group words into one argument so paths may contain spaces.
+ * 
+ * @param line The text to split
+ * @return std::vector<std::string> The arguments in order
+ */
+std::vector<std::string> splitArguments(const std::string& line) {
+    std::vector<std::string> arguments;
+    std::string current;
+    bool inQuotes = false;
+    bool hasArgument = false;
+
+    for (char c : line) {
+        if (c == '"') {
+            inQuotes = !inQuotes;
+            hasArgument = true;
+        } else if (!inQuotes && (c == ' ' || c == '\t')) {
+            if (hasArgument) {
+                arguments.push_back(current);
+                current.clear();
+                hasArgument = false;
+            }
+        } else {
+            current += c;
+            hasArgument = true;
+        }
+    }
+    if (hasArgument) {
+        arguments.push_back(current);
+    }
+    return arguments;
+}
+
+/**
+ * @brief Removes the double quotes from a single path argument
+ * 
+ * Commands that take one path read the rest of the line, so unquoted spaces
+ * are kept as well; quotes only need to go (as inserted by Tab completion).
+ * 
+ * @param argument The argument as typed
+ * @return std::string The argument without quote characters
+ */
+std::string unquote(const std::string& argument) {
+    std::string result;
+    for (char c : argument) {
+        if (c != '"') {
+            result += c;
+        }
     }
+    return result;
+}
+
+/**
+ * @brief Removes a trailing flag such as "--resume" from an argument line
+ * 
+ * @param arguments The argument line; the flag and the space before it are removed
+ * @param flag The flag to look for
+ * @return true if the flag was present
+ */
+bool takeFlag(std::string& arguments, const std::string& flag) {
+    if (arguments == flag) {
+        arguments.clear();
+        return true;
+    }
+    std::string suffix = " " + flag;
+    if (arguments.size() > suffix.size() &&
+        arguments.compare(arguments.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        arguments.erase(arguments.size() - suffix.size());
+        arguments.erase(arguments.find_last_not_of(" \t") + 1);
+        return true;
+    }
+    return false;
 }
 
 /**
@@ -33,19 +113,36 @@ void displayPrompt() {
  */
 void displayHelp() {
     std::cerr << "Available commands:\n"
-              << "  search <directory>     - Search for files/directories by name\n"
-              << "  display <directory>    - Show contents of directory\n"
+              << "  search <directory> [--xdev] [--nice] [--resume]\n"
+              << "                         - Search for files/directories by name\n"
+              << "  display <directory> [--xdev] [--nice] [--resume]\n"
+              << "                         - Show contents of directory\n"
               << "  cd [directory]         - Change directory (cd alone goes to home)\n"
+              << "  j [fragment]          - Jump to the best matching visited directory\n"
               << "  mkdir <directory>      - Create a new directory\n"
               << "  touch <file>          - Create a new empty file\n"
-              << "  rm <path>             - Delete a file or directory\n"
+              << "  rm <path> [--nice]    - Delete a file or directory\n"
               << "  mv <old> <new>        - Rename or move a file or directory\n"
+              << "  top <directory> [--by size|mtime] [-n count]\n"
+              << "                        - List the largest or newest files (default: 20 by size)\n"
+              << "  cache [clear]         - Show or clear the in-memory directory cache\n"
+              << "  nice [name=value...]  - Show or change the --nice rate limits\n"
+              << "  manifest create <directory> <manifest> [--sha256] [--nice]\n"
+              << "                        - Write checksums of all files (XXH64 unless --sha256)\n"
+              << "  manifest verify <manifest> [--full] [--update] [--nice]\n"
+              << "                        - Check a directory against its manifest\n"
               << "  help                  - Show this help message\n"
               << "  exit/quit             - Exit the program\n\n"
               << "Notes:\n"
               << "  - Paths can be absolute or relative to current directory\n"
               << "  - Use quotes for paths containing spaces\n"
-              << "  - Use ~ for home directory, .. for parent directory\n";
+              << "  - Use ~ for home directory, .. for parent directory\n"
+              << "  - Press Tab to complete commands and paths\n"
+              << "  - An interrupted search or display (Ctrl-C, lost connection) can be\n"
+              << "    continued with --resume; the directory may then be left out\n"
+              << "  - --xdev keeps search and display on one file system\n"
+              << "  - --nice rate limits a command so it does not slow down other programs;\n"
+              << "    limits changed with nice apply to commands that are already running\n";
 }
 
 /**
@@ -57,13 +154,22 @@ void displayHelp() {
  * @return int Exit code (0 for success, 1 for error)
  */
 int main() {
+    std::string line;
     std::string command;
-    std::string arg1, arg2;
+    std::string arg1;
     
     while (true) {  // Main program loop
         try {
-            displayPrompt();
-            std::cin >> command;
+            if (!readCommandLine(buildPrompt(), line)) {
+                // End of input (e.g. the terminal went away)
+                std::cout << "\n";
+                break;
+            }
+
+            std::istringstream input(line);
+            if (!(input >> command)) {
+                continue;
+            }
             
             // Check for exit commands first
             if (command == "exit" || command == "quit") {
@@ -80,71 +186,158 @@ int main() {
             // Handle cd command differently as it might have empty directory
             if (command == "cd") {
                 std::string cdPath;
-                std::getline(std::cin >> std::ws, cdPath);
+                std::getline(input >> std::ws, cdPath);
+                // Tab completion leaves a space after a completed name
+                cdPath.erase(cdPath.find_last_not_of(" \t") + 1);
+                cdPath = unquote(cdPath);
                 
                 // If no path specified, go to home directory
-                if (cdPath.empty()) {
-                    fsCd("~");
-                } else {
-                    fsCd(cdPath);
+                if (fsCd(cdPath.empty() ? "~" : cdPath)) {
+                    prepareCompletion(getCurrentDirectory());
                 }
                 continue;
             }
 
             // Handle mv command which needs two arguments
             if (command == "mv") {
-                std::getline(std::cin >> std::ws, arg1, ' ');
-                std::getline(std::cin >> std::ws, arg2);
+                std::string rest;
+                std::getline(input >> std::ws, rest);
+                std::vector<std::string> arguments = splitArguments(rest);
                 
-                if (arg1.empty() || arg2.empty()) {
+                if (arguments.size() != 2 || arguments[0].empty() || arguments[1].empty()) {
                     std::cerr << "Error: mv command requires two arguments: <old_path> <new_path>\n";
                     continue;
                 }
                 
-                fsRename(arg1, arg2);
+                fsRename(arguments[0], arguments[1]);
                 continue;
             }
             
-            // Handle other commands that take one argument
-            std::getline(std::cin >> std::ws, arg1);
+            // Handle other commands that take one argument (empty if none was given)
+            arg1.clear();
+            std::getline(input >> std::ws, arg1);
+            arg1.erase(arg1.find_last_not_of(" \t") + 1);
 
-            if (std::cin.fail()) {
-                std::cerr << "Error: Failed to read input\n";
-                std::cin.clear();
-                std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-                continue;
-            }
-
-            if (command == "search") {
-                if (arg1.empty()) {
-                    std::cerr << "Error: search command requires a directory path\n";
-                    continue;
+            if (command == "search" || command == "display") {
+                // Trailing flags, in any order
+                bool resume = false;
+                bool sameDevice = false;
+                bool nice = false;
+                while (true) {
+                    if (takeFlag(arg1, "--resume")) {
+                        resume = true;
+                    } else if (takeFlag(arg1, "--xdev")) {
+                        sameDevice = true;
+                    } else if (takeFlag(arg1, "--nice")) {
+                        nice = true;
+                    } else {
+                        break;
+                    }
                 }
-                fsSearch(arg1);
-            } else if (command == "display") {
-                if (arg1.empty()) {
-                    std::cerr << "Error: display command requires a directory path\n";
+                arg1 = unquote(arg1);
+                if (arg1.empty() && !resume) {
+                    std::cerr << "Error: " << command << " command requires a directory path\n";
                     continue;
                 }
-                fsDisplay(arg1);
+                if (command == "search") {
+                    fsSearch(arg1, resume, sameDevice, nice);
+                } else {
+                    fsDisplay(arg1, resume, sameDevice, nice);
+                }
             } else if (command == "mkdir") {
+                arg1 = unquote(arg1);
                 if (arg1.empty()) {
                     std::cerr << "Error: mkdir command requires a directory path\n";
                     continue;
                 }
                 fsCreate(arg1, true);
             } else if (command == "touch") {
+                arg1 = unquote(arg1);
                 if (arg1.empty()) {
                     std::cerr << "Error: touch command requires a file path\n";
                     continue;
                 }
                 fsCreate(arg1, false);
             } else if (command == "rm") {
+                bool nice = takeFlag(arg1, "--nice");
+                arg1 = unquote(arg1);
                 if (arg1.empty()) {
                     std::cerr << "Error: rm command requires a path\n";
                     continue;
                 }
-                fsDelete(arg1);
+                fsDelete(arg1, nice);
+            } else if (command == "j") {
+                if (fsJump(arg1)) {
+                    prepareCompletion(getCurrentDirectory());
+                }
+            } else if (command == "manifest") {
+                std::vector<std::string> arguments = splitArguments(arg1);
+                std::vector<std::string> paths;
+                bool sha256 = false;
+                bool full = false;
+                bool update = false;
+                bool nice = false;
+                for (size_t i = 1; i < arguments.size(); i++) {
+                    if (arguments[i] == "--sha256") {
+                        sha256 = true;
+                    } else if (arguments[i] == "--full") {
+                        full = true;
+                    } else if (arguments[i] == "--update") {
+                        update = true;
+                    } else if (arguments[i] == "--nice") {
+                        nice = true;
+                    } else {
+                        paths.push_back(arguments[i]);
+                    }
+                }
+
+                std::string action = arguments.empty() ? "" : arguments[0];
+                if (action == "create" && paths.size() == 2 && !full && !update) {
+                    fsManifestCreate(paths[0], paths[1], sha256, nice);
+                } else if (action == "verify" && paths.size() == 1 && !sha256) {
+                    fsManifestVerify(paths[0], full, update, nice);
+                } else {
+                    std::cerr << "Error: usage: manifest create <directory> <manifest> [--sha256] [--nice]\n"
+                              << "              manifest verify <manifest> [--full] [--update] [--nice]\n";
+                }
+            } else if (command == "nice") {
+                fsNice(arg1);
+            } else if (command == "cache") {
+                fsCache(arg1);
+            } else if (command == "top") {
+                std::vector<std::string> arguments = splitArguments(arg1);
+                std::string topDirectory;
+                bool byModificationTime = false;
+                size_t count = 20;
+                bool valid = true;
+
+                for (size_t i = 0; i < arguments.size() && valid; i++) {
+                    if (arguments[i] == "--by" && i + 1 < arguments.size()) {
+                        const std::string& order = arguments[++i];
+                        byModificationTime = (order == "mtime");
+                        valid = (order == "size" || order == "mtime");
+                    } else if (arguments[i] == "-n" && i + 1 < arguments.size()) {
+                        const std::string& number = arguments[++i];
+                        valid = !number.empty() && number.find_first_not_of("0123456789") == std::string::npos;
+                        if (valid) {
+                            try {
+                                count = std::stoul(number);
+                            } catch (const std::out_of_range&) {
+                                valid = false;
+                            }
+                        }
+                    } else if (topDirectory.empty()) {
+                        topDirectory = arguments[i];
+                    } else {
+                        valid = false;
+                    }
+                }
+
+                if (!valid || topDirectory.empty()) {
+                    std::cerr << "Error: usage: top <directory> [--by size|mtime] [-n count]\n";
+                    continue;
+                }
+                fsTop(topDirectory, byModificationTime, count);
             } else {
                 displayHelp();
             }
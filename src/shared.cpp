@@ -1,8 +1,11 @@
 //Used for shared variables between files
 
 #include "fs.h"
+#include "fs_tree.h"
 #include <vector>
 #include <string>
+#include <cstdlib>
+#include <filesystem>
 
 /**
  * @brief List of system paths that should be skipped during traversal
@@ -25,4 +28,51 @@ bool shouldSkipPath(const std::string& path) {
         }
     }
     return false;
-}
\ No newline at end of file
+}
+
+FsTree& fileTree() {
+    static FsTree tree;
+    return tree;
+}
+
+std::string getHomeDirectory() {
+    const char* homeDir = std::getenv("USERPROFILE"); // Windows
+    if (!homeDir) {
+        homeDir = std::getenv("HOME"); // Unix-like systems
+    }
+    return homeDir ? std::string(homeDir) : std::string();
+}
+
+std::filesystem::path getStateDirectory() {
+    std::string homeDir = getHomeDirectory();
+    std::filesystem::path base = homeDir.empty() ? std::filesystem::current_path() : std::filesystem::path(homeDir);
+    return base / ".optimized_explorer";
+}
+
+std::string escapeLine(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\') {
+            result += "\\\\";
+        } else if (c == '\n') {
+            result += "\\n";
+        } else {
+            result += c;
+        }
+    }
+    return result;
+}
+
+std::string unescapeLine(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '\\' && i + 1 < value.size()) {
+            result += (value[++i] == 'n') ? '\n' : value[i];
+        } else {
+            result += value[i];
+        }
+    }
+    return result;
+}